@@ -2,28 +2,48 @@
 #include <HTTPClient.h>
 #include "esp_camera.h"
 
+#include "src/Core/ChangeDetector.h"
 #include "src/Core/EdgeProcessor.h"
 #include "src/Core/PacketBuilder.h"
 #include "src/Core/SerialProtocol.h"
+#include "src/HAL/AsyncCapture.h"
 #include "src/HAL/EspCamera.h"
 
 const char* SSID = "NOME_DA_SUA_REDE";
 const char* PASSWORD = "SENHA_DA_SUA_REDE";
 const char* API_ENDPOINT = "http://seu-backend.com/api/ingest-scan";
 
+const unsigned long CICLO_MS = 5000;              // periodo de inspecao
+const unsigned long CICLO_DESCARTE_MS = 1000;     // nova tentativa depois de um frame descartado
+const unsigned long ANTECEDENCIA_CAPTURA_MS = 300; // a captura comeca esse tempo antes do fim do ciclo
+
 EspCamera camera;
+// Captura em segundo plano, pedida pouco antes do fim de cada ciclo: o frame chega fresco (e nao
+// com a idade do ciclo) e a espera pela captura some do ciclo.
+AsyncCapture capture(camera);
 EdgeProcessor processor;
+AnalysisResult result; // reaproveitado a cada ciclo: sem alocacoes na PSRAM em regime
+ChangeDetector changeDetector;
+int ciclosSemMudanca = 0;
 
 void setup() {
     Serial.begin(115200);
     Serial.println("\n[BOOT] Iniciando Inspection Edge Node...");
 
+    // Um fb so (1.9 MB em UXGA) cabe na PSRAM ao lado dos buffers da analise; basta porque o
+    // frame do ciclo e solto antes de a proxima captura ser pedida.
+    camera.setFrameBuffers(1);
     if (!camera.init()) {
         Serial.println("[ERRO] Falha crítica no hardware da câmara! Reiniciando...");
         delay(5000);
         ESP.restart();
     }
     Serial.println("[HARDWARE] Câmara Inicializada (PSRAM Ativa).");
+    capture.setPrefetch(false);
+    capture.start();
+    processor.setSegmentation(true);
+    processor.setOrientationOutput(true);
+    processor.setSharpnessGate(true);   // so mede; calibrar o descarte na instalacao (calibrateSharpnessGate)
 
     WiFi.begin(SSID, PASSWORD);
     Serial.print("[WIFI] Tentando conectar");
@@ -42,31 +62,74 @@ void setup() {
     }
 }
 
+// Espera ate o fim do ciclo (contado do inicio, entao o tempo de analise e envio nao soma) e
+// pede a proxima captura ANTECEDENCIA_CAPTURA_MS antes. O frame do ciclo ja tem que estar solto.
+void esperarProximoCiclo(unsigned long inicioCiclo, unsigned long periodoMs) {
+    unsigned long decorrido = millis() - inicioCiclo;
+    if (decorrido + ANTECEDENCIA_CAPTURA_MS < periodoMs) delay(periodoMs - decorrido - ANTECEDENCIA_CAPTURA_MS);
+    capture.request();
+    decorrido = millis() - inicioCiclo;
+    if (decorrido < periodoMs) delay(periodoMs - decorrido);
+}
+
 void loop() {
+    unsigned long inicioCiclo = millis();
     Serial.println("\n>>> INICIANDO CICLO DE INSPEÇÃO <<<");
 
-    ImageFrame frame = camera.capture();
-    if (!frame.valid) {
+    FrameLease frame = capture.acquire();
+    if (!frame.valid()) {
         Serial.println("[ERRO] Frame inválido capturado.");
-        delay(1000);
+        esperarProximoCiclo(inicioCiclo, CICLO_DESCARTE_MS);
+        return;
+    }
+
+    // Sensores lidos junto com o frame: o pacote descreve o mesmo instante (carimbo da captura).
+    std::time_t capturadoEm = capture.capturedAt();
+    SensorData sensors;
+    sensors.imu = {0.0f, 0.0f, 9.8f, 0.0f, 0.0f, 0.0f};
+    sensors.distance_mm = 350.0;
+    sensors.light_lux = 400.0;
+
+    String chipId = String((uint32_t)ESP.getEfuseMac(), HEX);
+
+    // Cena igual a do ultimo frame analisado: sem analise e sem pacote completo, so um heartbeat.
+    if (!changeDetector.changed(frame)) {
+        frame.reset();
+        ciclosSemMudanca++;
+        Serial.printf("[EDGE] Cena sem mudanca (diferenca %d) | Heartbeat %d\n", changeDetector.lastDifference(), ciclosSemMudanca);
+        enviarPacote(PacketBuilder::heartbeat(chipId.c_str(), result, ciclosSemMudanca));
+        esperarProximoCiclo(inicioCiclo, CICLO_MS);
         return;
     }
+    ciclosSemMudanca = 0;
 
     unsigned long t_inicio = millis();
-    AnalysisResult result = processor.analyze(frame);
+    processor.analyze(frame, result);
     unsigned long t_fim = millis();
     result.process_time_ms = (t_fim - t_inicio);
+    frame.reset();   // devolve o fb ao driver antes da proxima captura
 
-    Serial.printf("[EDGE] Bordas: %.2f%% | Tempo: %lums\n", result.edge_density * 100, result.process_time_ms);
+    if (result.reject_reason != RejectReason::None) {
+        // Frame tremido/fora de foco: nao vira leitura de "sem fissura"; tenta de novo no proximo ciclo.
+        QualityStats stats = processor.qualityStats();
+        Serial.printf("[EDGE] Frame descartado (%s, nitidez %u) | Descartes: %u/%u\n", rejectReasonName(result.reject_reason),
+                      (unsigned)result.sharpness, (unsigned)stats.rejected, (unsigned)stats.frames);
+        changeDetector.reset();   // o proximo frame e analisado mesmo se a cena nao mudar
+        esperarProximoCiclo(inicioCiclo, CICLO_DESCARTE_MS);
+        return;
+    }
 
-    SensorData sensors;
-    sensors.imu = {0.0, 0.0, 9.8};
-    sensors.distance_mm = 350.0;
-    sensors.light_lux = 400.0;
+    // Build sem float: a densidade vem em Q16 e e formatada em inteiro.
+    Serial.printf("[EDGE] Bordas: %s%% | Trechos: %u | Direcao: %d graus | Tempo: %lums\n",
+                  q16::format(result.edge_density_q16 * 100, 2).c_str(), (unsigned)result.segments.size(),
+                  result.dominant_direction_deg, result.process_time_ms);
 
-    String chipId = String((uint32_t)ESP.getEfuseMac(), HEX);
-    std::string jsonPayload = PacketBuilder::build(chipId.c_str(), sensors, result);
-    
+    enviarPacote(PacketBuilder::build(chipId.c_str(), sensors, result, capturadoEm));
+
+    esperarProximoCiclo(inicioCiclo, CICLO_MS);
+}
+
+void enviarPacote(const std::string& jsonPayload) {
     if (WiFi.status() == WL_CONNECTED) {
         WiFiClient client;
         HTTPClient http;
@@ -88,10 +151,6 @@ void loop() {
         Serial.println("[OFFLINE] Wi-Fi indisponível. Usando contingência Serial.");
         enviarViaSerial(jsonPayload);
     }
-
-    camera.returnFrame(frame);
-
-    delay(5000);
 }
 
 void enviarViaSerial(const std::string& json) {
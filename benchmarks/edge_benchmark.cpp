@@ -0,0 +1,213 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <vector>
+#include <thread>
+#include <cstdlib>
+
+#include "HAL/ICamera.h"
+#include "Core/EdgeProcessor.h"
+
+// Frame sintetico: textura de concreto (ruido) com algumas fissuras escuras.
+ImageFrame gerarFrame(int w, int h) {
+    ImageFrame frame;
+    frame.width = w;
+    frame.height = h;
+    frame.valid = true;
+    frame.data.resize(w * h);
+
+    std::mt19937 rng(1234);
+    for (auto& p : frame.data) p = 110 + (rng() % 40);
+
+    for (int k = 0; k < 5; k++) {
+        int x0 = rng() % w;
+        for (int y = 0; y < h; y++) {
+            int x = (x0 + y / 3) % w;
+            frame.data[y * w + x] = 20;
+        }
+    }
+    return frame;
+}
+
+// Concreto liso: textura de +-2 niveis e tres fissuras finas curtas (a maior parte dos tiles sem borda).
+ImageFrame gerarFrameLiso(int w, int h) {
+    ImageFrame frame;
+    frame.width = w;
+    frame.height = h;
+    frame.valid = true;
+    frame.data.resize(w * h);
+
+    std::mt19937 rng(4321);
+    for (auto& p : frame.data) p = 128 + (rng() % 5) - 2;
+
+    for (int k = 0; k < 3; k++) {
+        int x0 = rng() % w;
+        int y0 = rng() % (h / 2);
+        for (int y = y0; y < y0 + h / 3; y++) {
+            int x = (x0 + (y - y0) / 4) % w;
+            frame.data[y * w + x] = 70;
+        }
+    }
+    return frame;
+}
+
+double medirMsPorFrame(EdgeProcessor& processor, const ImageFrame& frame, int duracaoMs = 500) {
+    processor.analyze(frame);
+
+    int iteracoes = 0;
+    auto start = std::chrono::steady_clock::now();
+    auto end = start;
+    do {
+        processor.analyze(frame);
+        iteracoes++;
+        end = std::chrono::steady_clock::now();
+    } while (end - start < std::chrono::milliseconds(duracaoMs));
+
+    return std::chrono::duration<double, std::milli>(end - start).count() / iteracoes;
+}
+
+double mediana(std::vector<double> valores) {
+    std::sort(valores.begin(), valores.end());
+    return valores[valores.size() / 2];
+}
+
+int main(int argc, char** argv) {
+    struct Resolucao { const char* nome; int w; int h; };
+    const Resolucao resolucoes[] = {
+        { "QVGA", 320, 240 },
+        { "VGA", 640, 480 },
+        { "UXGA", 1600, 1200 },
+    };
+
+    std::cout << "==========================================\n";
+    std::cout << "   BENCHMARK: EdgeProcessor::analyze\n";
+    std::cout << "==========================================\n";
+    std::cout << "Kernels detectados: " << bestEdgeKernels().name << "\n\n";
+
+    std::cout << std::left << std::setw(8) << "Res" << std::setw(10) << "Kernels"
+              << std::right << std::setw(12) << "ms/frame" << std::setw(10) << "Speedup" << "\n";
+
+    for (const Resolucao& r : resolucoes) {
+        ImageFrame frame = gerarFrame(r.w, r.h);
+        double referencia = 0;
+
+        for (KernelIsa isa : { KernelIsa::Scalar, KernelIsa::SSE2, KernelIsa::AVX2 }) {
+            EdgeProcessor processor;
+            if (!processor.setKernels(isa)) continue;
+
+            double ms = medirMsPorFrame(processor, frame);
+            if (isa == KernelIsa::Scalar) referencia = ms;
+
+            std::cout << std::left << std::setw(8) << r.nome << std::setw(10) << processor.activeKernels().name
+                      << std::right << std::setw(12) << std::fixed << std::setprecision(3) << ms
+                      << std::setw(9) << std::setprecision(2) << (referencia / ms) << "x\n";
+        }
+    }
+
+    // Cena parada: modo incremental reaproveitando todos os tiles a partir do segundo frame.
+    std::cout << "\nCena parada (modo incremental, tiles 64x64):\n";
+    for (const Resolucao& r : resolucoes) {
+        ImageFrame frame = gerarFrame(r.w, r.h);
+
+        EdgeProcessor completo;
+        EdgeProcessor incremental;
+        incremental.setIncremental(true);
+
+        double msCompleto = medirMsPorFrame(completo, frame);
+        double msIncremental = medirMsPorFrame(incremental, frame);
+
+        std::cout << std::left << std::setw(8) << r.nome << std::setw(10) << "incr"
+                  << std::right << std::setw(12) << std::fixed << std::setprecision(3) << msIncremental
+                  << std::setw(9) << std::setprecision(2) << (msCompleto / msIncremental) << "x\n";
+    }
+
+    // Piramide: troca de precisao por velocidade conforme a guarda de contraste (UXGA), no frame
+    // ruidoso de sempre e num concreto liso (textura fraca) com fissuras finas.
+    for (bool liso : { false, true }) {
+        ImageFrame frame = liso ? gerarFrameLiso(1600, 1200) : gerarFrame(1600, 1200);
+        EdgeProcessor completo;
+        double msCompleto = medirMsPorFrame(completo, frame);
+        uint32_t exata = completo.analyze(frame).edge_density_q16;
+
+        std::cout << "\nPiramide UXGA " << (liso ? "lisa" : "ruidosa") << " (completo " << std::setprecision(3)
+                  << msCompleto << " ms, densidade exata " << q16::format(exata * 100, 4) << "%):\n";
+        std::cout << std::left << std::setw(8) << "Guarda" << std::right << std::setw(10) << "Tiles"
+                  << std::setw(12) << "ms/frame" << std::setw(10) << "Speedup" << std::setw(12) << "Densidade" << "\n";
+
+        for (int guarda : { -1, 20, 40, 80 }) {
+            EdgeProcessor processor;
+            processor.setPyramid(true, guarda);
+            AnalysisResult r = processor.analyze(frame);
+            double ms = medirMsPorFrame(processor, frame);
+
+            std::cout << std::left << std::setw(8) << (guarda < 0 ? "auto" : std::to_string(guarda)) << std::right
+                      << std::setw(6) << r.tiles_refined << "/" << std::setw(3) << r.tiles_total
+                      << std::setw(12) << std::setprecision(3) << ms
+                      << std::setw(9) << std::setprecision(2) << (msCompleto / ms) << "x"
+                      << std::setw(11) << q16::format(r.edge_density_q16 * 100, 4) << "%\n";
+        }
+    }
+
+    // Limiar adaptativo: custo do histograma + segundo passo sobre o limiar fixo.
+    std::cout << "\nLimiar adaptativo (Otsu) x fixo (mediana de 15 rodadas):\n";
+    std::cout << std::left << std::setw(8) << "Res" << std::setw(10) << "Kernels" << std::right
+              << std::setw(10) << "Fixo" << std::setw(10) << "Otsu" << std::setw(10) << "Custo" << std::setw(8) << "Limiar" << "\n";
+    for (const Resolucao& r : resolucoes) {
+        ImageFrame frame = gerarFrame(r.w, r.h);
+        for (KernelIsa isa : { KernelIsa::Scalar, KernelIsa::SSE2, KernelIsa::AVX2 }) {
+            EdgeProcessor fixo;
+            EdgeProcessor otsu;
+            if (!fixo.setKernels(isa) || !otsu.setKernels(isa)) continue;
+            otsu.setThresholdMode(ThresholdMode::Otsu);
+
+            // Rodadas curtas intercaladas, em ordem alternada; o custo e a mediana da razao de cada
+            // par de rodadas vizinhas, que viram a mesma frequencia da CPU.
+            std::vector<double> rodadasFixo, rodadasOtsu, razoes;
+            for (int k = 0; k < 15; k++) {
+                double msFixo, msOtsu;
+                if (k % 2 == 0) {
+                    msFixo = medirMsPorFrame(fixo, frame, 30);
+                    msOtsu = medirMsPorFrame(otsu, frame, 30);
+                } else {
+                    msOtsu = medirMsPorFrame(otsu, frame, 30);
+                    msFixo = medirMsPorFrame(fixo, frame, 30);
+                }
+                rodadasFixo.push_back(msFixo);
+                rodadasOtsu.push_back(msOtsu);
+                razoes.push_back(msOtsu / msFixo);
+            }
+            std::cout << std::left << std::setw(8) << r.nome << std::setw(10) << fixo.activeKernels().name << std::right
+                      << std::setw(10) << std::fixed << std::setprecision(3) << mediana(rodadasFixo)
+                      << std::setw(10) << mediana(rodadasOtsu)
+                      << std::setw(9) << std::setprecision(1) << (mediana(razoes) - 1) * 100 << "%"
+                      << std::setw(8) << otsu.analyze(frame).threshold << "\n";
+        }
+    }
+
+    // Escalonamento do modo em faixas: UXGA com os melhores kernels, de 1 a N threads.
+    // N = nucleos da maquina, ou o primeiro argumento da linha de comando.
+    unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    if (argc > 1) maxThreads = std::max(1, std::atoi(argv[1]));
+    ImageFrame uxga = gerarFrame(1600, 1200);
+    double serial = 0;
+
+    std::cout << "\nEscalonamento UXGA (" << bestEdgeKernels().name << "), " << maxThreads << " threads:\n";
+    std::cout << std::left << std::setw(10) << "Threads"
+              << std::right << std::setw(12) << "ms/frame" << std::setw(10) << "Speedup" << "\n";
+
+    for (unsigned t = 1; t <= maxThreads; t++) {
+        EdgeProcessor processor;
+        processor.setThreadCount((int)t);
+
+        double ms = medirMsPorFrame(processor, uxga);
+        if (t == 1) serial = ms;
+
+        std::cout << std::left << std::setw(10) << t
+                  << std::right << std::setw(12) << std::fixed << std::setprecision(3) << ms
+                  << std::setw(9) << std::setprecision(2) << (serial / ms) << "x\n";
+    }
+
+    return 0;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <algorithm>
+#include <string>
+#include "EdgeMask.h"
+
+// Gera o mapa ASCII (. liso, # fissura) a partir da mascara, so quando alguem precisa dele.
+// Com step > 1 cada caractere representa um bloco step x step, marcado se tiver qualquer borda.
+class AsciiRenderer {
+public:
+    static std::string render(const EdgeMask& mask, int step = 1) {
+        if (step < 1) step = 1;
+        int cols = (mask.width + step - 1) / step;
+        int lines = (mask.height + step - 1) / step;
+
+        std::string map((size_t)(cols + 1) * lines, '.');
+        for (int by = 0; by < lines; by++) {
+            char* out = &map[(size_t)by * (cols + 1)];
+            out[cols] = '\n';
+
+            int yEnd = std::min(mask.height, (by + 1) * step);
+            for (int y = by * step; y < yEnd; y++) {
+                const uint64_t* row = mask.row(y);
+                for (int w = 0; w < mask.wordsPerRow; w++) {
+                    for (uint64_t word = row[w]; word; word &= word - 1) {
+                        int x = w * 64 + __builtin_ctzll(word);
+                        out[x / step] = '#';
+                    }
+                }
+            }
+        }
+        return map;
+    }
+};
@@ -0,0 +1,77 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "../HAL/ImageView.h"
+
+// Detector de mudanca de cena para pular ciclos de inspecao redundantes.
+// Cada frame vira uma miniatura de 1/8 (media de blocos 8x8, sobras de borda ignoradas) e e
+// comparado com a miniatura do ultimo frame que mudou, pela diferenca absoluta media.
+// A referencia so e trocada quando changed() devolve true: uma deriva lenta (luz, vibracao) se
+// acumula contra o ultimo frame analisado ate passar do limiar, em vez de sumir aos poucos.
+// A media olha o frame todo: mudancas muito pequenas (poucos blocos) podem ficar abaixo do limiar.
+class ChangeDetector {
+public:
+    // threshold: diferenca media minima, em niveis de cinza da miniatura, para contar como mudanca.
+    explicit ChangeDetector(int threshold = 2) : threshold(threshold) {}
+
+    void setThreshold(int value) { threshold = value; }
+    int getThreshold() const { return threshold; }
+
+    // Primeiro frame, mudanca de resolucao ou frame menor que um bloco sempre contam como mudanca.
+    bool changed(const ImageView& image) {
+        int tw = image.width / 8;
+        int th = image.height / 8;
+        if (tw == 0 || th == 0) {
+            reference.clear();
+            difference = 0;
+            return true;
+        }
+
+        thumbnail(image, tw, th, current);
+        bool first = reference.size() != current.size() || referenceWidth != tw;
+        uint64_t sum = 0;
+        if (!first) {
+            for (size_t i = 0; i < current.size(); i++) {
+                int d = (int)current[i] - (int)reference[i];
+                sum += (uint32_t)(d < 0 ? -d : d);
+            }
+        }
+        difference = first ? 0 : (int)(sum / current.size());
+
+        if (!first && sum < (uint64_t)threshold * current.size()) return false;
+        reference.swap(current);
+        referenceWidth = tw;
+        return true;
+    }
+
+    // Diferenca media (truncada) medida na ultima chamada; 0 quando nao havia referencia.
+    int lastDifference() const { return difference; }
+
+    // Esquece a referencia: o proximo frame conta como mudanca.
+    void reset() { reference.clear(); }
+
+private:
+    // Media dos blocos 8x8: 8 linhas somadas por coluna de bloco, uma passada sobre a imagem.
+    void thumbnail(const ImageView& image, int tw, int th, std::vector<uint8_t>& out) {
+        out.resize((size_t)tw * th);
+        sums.resize(tw);
+        for (int ty = 0; ty < th; ty++) {
+            for (int tx = 0; tx < tw; tx++) sums[tx] = 0;
+            for (int r = 0; r < 8; r++) {
+                const uint8_t* row = image.row(ty * 8 + r);
+                for (int tx = 0; tx < tw; tx++) {
+                    const uint8_t* p = row + tx * 8;
+                    sums[tx] += p[0] + p[1] + p[2] + p[3] + p[4] + p[5] + p[6] + p[7];
+                }
+            }
+            for (int tx = 0; tx < tw; tx++) out[(size_t)ty * tw + tx] = (uint8_t)(sums[tx] / 64);
+        }
+    }
+
+    int threshold;
+    int difference = 0;
+    int referenceWidth = 0;
+    std::vector<uint8_t> reference;
+    std::vector<uint8_t> current;
+    std::vector<uint32_t> sums;
+};
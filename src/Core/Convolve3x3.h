@@ -0,0 +1,158 @@
+#pragma once
+#include <cstdint>
+
+// Convolucao 3x3 com coeficientes conhecidos em tempo de compilacao.
+// Cada kernel e uma struct com `static constexpr int taps[3][3]` (linha y-1, y, y+1; coluna x-1, x, x+1).
+// Convolve3x3<K> detecta em compile time se o kernel e separavel (posto 1) e, nesse caso, calcula
+// somas verticais so das colunas com peso horizontal != 0. Taps zero nao geram nem a leitura do pixel,
+// e pesos +-1 viram soma/subtracao; o resultado e codigo desenrolado que o compilador vetoriza.
+
+struct Gaussian3x3 {
+    static constexpr int taps[3][3] = { { 1, 2, 1 }, { 2, 4, 2 }, { 1, 2, 1 } };
+};
+
+struct Box3x3 {
+    static constexpr int taps[3][3] = { { 1, 1, 1 }, { 1, 1, 1 }, { 1, 1, 1 } };
+};
+
+struct SobelX {
+    static constexpr int taps[3][3] = { { -1, 0, 1 }, { -2, 0, 2 }, { -1, 0, 1 } };
+};
+
+struct SobelY {
+    static constexpr int taps[3][3] = { { -1, -2, -1 }, { 0, 0, 0 }, { 1, 2, 1 } };
+};
+
+struct ScharrX {
+    static constexpr int taps[3][3] = { { -3, 0, 3 }, { -10, 0, 10 }, { -3, 0, 3 } };
+};
+
+struct ScharrY {
+    static constexpr int taps[3][3] = { { -3, -10, -3 }, { 0, 0, 0 }, { 3, 10, 3 } };
+};
+
+struct PrewittX {
+    static constexpr int taps[3][3] = { { -1, 0, 1 }, { -1, 0, 1 }, { -1, 0, 1 } };
+};
+
+struct PrewittY {
+    static constexpr int taps[3][3] = { { -1, -1, -1 }, { 0, 0, 0 }, { 1, 1, 1 } };
+};
+
+namespace conv3x3 {
+
+struct Factors {
+    int col[3];   // pesos verticais (linhas y-1, y, y+1)
+    int row[3];   // pesos horizontais (colunas x-1, x, x+1)
+};
+
+constexpr int absInt(int v) { return v < 0 ? -v : v; }
+
+constexpr int gcdInt(int a, int b) {
+    a = absInt(a);
+    b = absInt(b);
+    while (b != 0) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Posto 1 <=> todos os menores 2x2 sao nulos (e o kernel nao e todo zero).
+constexpr bool isSeparable(const int (&k)[3][3]) {
+    bool anyNonZero = false;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            if (k[i][j] != 0) anyNonZero = true;
+            for (int p = 0; p < 3; p++) {
+                for (int q = 0; q < 3; q++) {
+                    if (k[i][j] * k[p][q] != k[i][q] * k[p][j]) return false;
+                }
+            }
+        }
+    }
+    return anyNonZero;
+}
+
+// Fatoracao inteira k = col * row, com row primitivo (mdc 1). So faz sentido se isSeparable(k).
+constexpr Factors factor(const int (&k)[3][3]) {
+    Factors f = { { 0, 0, 0 }, { 0, 0, 0 } };
+    int r = 0;
+    while (r < 2 && k[r][0] == 0 && k[r][1] == 0 && k[r][2] == 0) r++;
+
+    int g = gcdInt(gcdInt(k[r][0], k[r][1]), k[r][2]);
+    if (g == 0) return f;
+    for (int j = 0; j < 3; j++) f.row[j] = k[r][j] / g;
+
+    int jn = 0;
+    while (jn < 2 && f.row[jn] == 0) jn++;
+    for (int i = 0; i < 3; i++) f.col[i] = k[i][jn] / f.row[jn];
+    return f;
+}
+
+constexpr int countNonZero(const int (&k)[3][3]) {
+    int n = 0;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) n += k[i][j] != 0;
+    }
+    return n;
+}
+
+// Um tap com peso C: peso 0 nao le o pixel, +-1 nao multiplica.
+template <int C>
+inline int tap(const uint8_t* p) {
+    if constexpr (C == 0) return 0;
+    else if constexpr (C == 1) return *p;
+    else if constexpr (C == -1) return -(int)*p;
+    else return C * (int)*p;
+}
+
+template <int C>
+inline int weight(int v) {
+    if constexpr (C == 0) return 0;
+    else if constexpr (C == 1) return v;
+    else if constexpr (C == -1) return -v;
+    else return C * v;
+}
+
+}
+
+template <class K>
+struct Convolve3x3 {
+    static constexpr bool separable = conv3x3::isSeparable(K::taps);
+    static constexpr conv3x3::Factors factors = conv3x3::factor(K::taps);
+    static constexpr int nonZeroTaps = conv3x3::countNonZero(K::taps);
+
+    // Resposta do kernel no pixel x, com r0, r1, r2 = linhas y-1, y, y+1 (sem clamp: 1 <= x <= w-2).
+    static inline int at(const uint8_t* r0, const uint8_t* r1, const uint8_t* r2, int x) {
+        if constexpr (separable) {
+            return conv3x3::weight<factors.row[0]>(column<factors.row[0]>(r0, r1, r2, x - 1))
+                 + conv3x3::weight<factors.row[1]>(column<factors.row[1]>(r0, r1, r2, x))
+                 + conv3x3::weight<factors.row[2]>(column<factors.row[2]>(r0, r1, r2, x + 1));
+        } else {
+            using conv3x3::tap;
+            return tap<K::taps[0][0]>(r0 + x - 1) + tap<K::taps[0][1]>(r0 + x) + tap<K::taps[0][2]>(r0 + x + 1)
+                 + tap<K::taps[1][0]>(r1 + x - 1) + tap<K::taps[1][1]>(r1 + x) + tap<K::taps[1][2]>(r1 + x + 1)
+                 + tap<K::taps[2][0]>(r2 + x - 1) + tap<K::taps[2][1]>(r2 + x) + tap<K::taps[2][2]>(r2 + x + 1);
+        }
+    }
+
+    // Aplica em out[1..w-2] de uma linha; Shift divide o resultado por 2^Shift (ex.: 4 no Gaussiano).
+    template <int Shift, class Out>
+    static inline void row(const uint8_t* r0, const uint8_t* r1, const uint8_t* r2, int w, Out* out) {
+        for (int x = 1; x < w - 1; x++) out[x] = (Out)(at(r0, r1, r2, x) >> Shift);
+    }
+
+private:
+    // Soma vertical de uma coluna; nem e calculada quando o peso horizontal dela e zero.
+    template <int RowWeight>
+    static inline int column(const uint8_t* r0, const uint8_t* r1, const uint8_t* r2, int x) {
+        if constexpr (RowWeight == 0) {
+            return 0;
+        } else {
+            using conv3x3::tap;
+            return tap<factors.col[0]>(r0 + x) + tap<factors.col[1]>(r1 + x) + tap<factors.col[2]>(r2 + x);
+        }
+    }
+};
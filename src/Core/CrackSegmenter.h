@@ -0,0 +1,185 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "EdgeMask.h"
+
+// Trecho de fissura: um componente conexo (vizinhanca 8) de pixels de borda.
+// Caixa inclusiva [x0, x1] x [y0, y1]; extent e a extensao, o maior lado da caixa em pixels.
+struct CrackSegment {
+    int x0, y0, x1, y1;
+    int pixels;
+    int extent;
+};
+
+// Rotulagem de componentes conexos em uma passada, linha a linha, sobre a mascara de bits.
+// Cada linha vira uma lista de runs (sequencias de bits ligados); runs que se tocam com a linha
+// anterior (incluindo diagonal) juntam seus rotulos por union-find. Um componente que nao aparece
+// na linha atual esta fechado: e emitido (se tiver ao menos minPixels) e seus rotulos voltam
+// para a lista livre. A memoria depende so dos componentes abertos e dos runs de duas linhas,
+// nunca do tamanho do frame; depois do primeiro frame segment() nao aloca em regime.
+class CrackSegmenter {
+public:
+    explicit CrackSegmenter(int minPixels = 16) : minPixels(minPixels) {}
+
+    void setMinPixels(int pixels) { minPixels = pixels; }
+    int getMinPixels() const { return minPixels; }
+
+    // Trechos em ordem de fechamento (de cima para baixo); out e limpo antes.
+    // Devolve quantos componentes foram descartados pelo filtro de tamanho.
+    int segment(const EdgeMask& mask, std::vector<CrackSegment>& out) {
+        out.clear();
+        previous.clear();
+        open.clear();
+        dropped = 0;
+
+        for (int y = 0; y < mask.height; y++) {
+            extractRuns(mask.row(y), mask.wordsPerRow, mask.width);
+            linkRuns(y);
+            closeFinished(y, out);
+            std::swap(previous, current);
+        }
+        closeFinished(mask.height, out);
+        return dropped;
+    }
+
+private:
+    struct Run {
+        int x0, x1;   // inclusivo
+        int label;
+    };
+
+    struct Component {
+        int parent;
+        int x0, y0, x1, y1;
+        int pixels;
+        int lastRow;
+    };
+
+    // Runs de bits ligados da linha, com ctz sobre as palavras (sem olhar pixel a pixel).
+    void extractRuns(const uint64_t* row, int words, int width) {
+        current.clear();
+        int start = -1;
+        for (int i = 0; i < words; i++) {
+            uint64_t word = row[i];
+            int base = i * 64;
+            int pos = 0;
+            while (pos < 64) {
+                uint64_t rest = word >> pos;
+                if (start < 0) {
+                    if (rest == 0) break;
+                    pos += __builtin_ctzll(rest);
+                    start = base + pos;
+                } else {
+                    uint64_t zeros = ~rest;
+                    if (pos > 0) zeros &= ~0ull >> pos;
+                    if (zeros == 0) break;
+                    pos += __builtin_ctzll(zeros);
+                    current.push_back({ start, base + pos - 1, -1 });
+                    start = -1;
+                }
+            }
+        }
+        if (start >= 0) current.push_back({ start, width - 1, -1 });
+    }
+
+    int find(int label) {
+        while (nodes[label].parent != label) {
+            nodes[label].parent = nodes[nodes[label].parent].parent;
+            label = nodes[label].parent;
+        }
+        return label;
+    }
+
+    // Junta b em a (ambos raizes, a < b). O rotulo filho so e liberado no fim da linha,
+    // depois que nenhum run da linha anterior aponta mais para ele.
+    void unite(int a, int b) {
+        if (a == b) return;
+        Component& root = nodes[a];
+        const Component& child = nodes[b];
+        root.x0 = std::min(root.x0, child.x0);
+        root.y0 = std::min(root.y0, child.y0);
+        root.x1 = std::max(root.x1, child.x1);
+        root.y1 = std::max(root.y1, child.y1);
+        root.pixels += child.pixels;
+        root.lastRow = std::max(root.lastRow, child.lastRow);
+        nodes[b].parent = a;
+        merged.push_back(b);
+    }
+
+    int newLabel(int y, const Run& run) {
+        int label;
+        if (!freeLabels.empty()) {
+            label = freeLabels.back();
+            freeLabels.pop_back();
+        } else {
+            label = (int)nodes.size();
+            nodes.push_back({});
+        }
+        nodes[label] = { label, run.x0, y, run.x1, y, 0, y };
+        open.push_back(label);
+        return label;
+    }
+
+    // Varredura casada das duas listas de runs (ambas ordenadas por x): um run toca o da linha
+    // anterior quando os intervalos, alargados em 1 pixel, se sobrepoem.
+    void linkRuns(int y) {
+        size_t p = 0;
+        for (Run& run : current) {
+            while (p < previous.size() && previous[p].x1 < run.x0 - 1) p++;
+
+            int label = -1;
+            for (size_t q = p; q < previous.size() && previous[q].x0 <= run.x1 + 1; q++) {
+                int other = find(previous[q].label);
+                if (label < 0) {
+                    label = other;
+                } else {
+                    unite(std::min(label, other), std::max(label, other));
+                    label = std::min(label, other);
+                }
+            }
+            if (label < 0) label = newLabel(y, run);
+
+            Component& c = nodes[label];
+            c.x0 = std::min(c.x0, run.x0);
+            c.x1 = std::max(c.x1, run.x1);
+            c.y1 = y;
+            c.pixels += run.x1 - run.x0 + 1;
+            c.lastRow = y;
+            run.label = label;
+        }
+        for (Run& run : current) run.label = find(run.label);
+    }
+
+    // Fecha os componentes que nao receberam pixels na linha y e recicla os rotulos fundidos.
+    void closeFinished(int y, std::vector<CrackSegment>& out) {
+        size_t kept = 0;
+        for (int label : open) {
+            const Component& c = nodes[label];
+            if (c.parent != label) continue;   // fundido em outro componente nesta linha
+            if (c.lastRow == y) {
+                open[kept++] = label;
+                continue;
+            }
+            if (c.pixels >= minPixels) {
+                int extent = std::max(c.x1 - c.x0, c.y1 - c.y0) + 1;
+                out.push_back({ c.x0, c.y0, c.x1, c.y1, c.pixels, extent });
+            } else {
+                dropped++;
+            }
+            freeLabels.push_back(label);
+        }
+        open.resize(kept);
+        freeLabels.insert(freeLabels.end(), merged.begin(), merged.end());
+        merged.clear();
+    }
+
+    int minPixels;
+    int dropped = 0;
+    std::vector<Run> previous;
+    std::vector<Run> current;
+    std::vector<Component> nodes;
+    std::vector<int> open;
+    std::vector<int> freeLabels;
+    std::vector<int> merged;
+};
@@ -0,0 +1,745 @@
+#include "EdgeKernels.h"
+#include "Convolve3x3.h"
+#include <algorithm>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define EDGE_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Caminho de borda do blur: so as colunas 0 e w-1, com o x dos taps limitado a [0, w-1].
+// O interior (1..w-2) nunca precisa de clamp e fica no laco sem desvios de cada kernel.
+inline uint8_t blurClampedPixel(const uint8_t* above, const uint8_t* row, const uint8_t* below, int w, int x) {
+    int l = x > 0 ? x - 1 : 0;
+    int r = x < w - 1 ? x + 1 : w - 1;
+    int sum = above[l] * 1 + above[x] * 2 + above[r] * 1
+            + row[l]   * 2 + row[x]   * 4 + row[r]   * 2
+            + below[l] * 1 + below[x] * 2 + below[r] * 1;
+    return sum / 16;
+}
+
+inline void blurBorderColumns(const uint8_t* above, const uint8_t* row, const uint8_t* below, int w, uint8_t* out) {
+    out[0] = blurClampedPixel(above, row, below, w, 0);
+    out[w - 1] = blurClampedPixel(above, row, below, w, w - 1);
+}
+
+void blurRowScalar(const uint8_t* above, const uint8_t* row, const uint8_t* below, int w, uint8_t* out) {
+    blurBorderColumns(above, row, below, w, out);
+    Convolve3x3<Gaussian3x3>::row<4>(above, row, below, w, out);
+}
+
+// Pares de kernels (gx, gy) de cada operador de gradiente.
+struct SobelOperator   { typedef SobelX X;   typedef SobelY Y; };
+struct ScharrOperator  { typedef ScharrX X;  typedef ScharrY Y; };
+struct PrewittOperator { typedef PrewittX X; typedef PrewittY Y; };
+
+// Decisao de borda sem raiz quadrada: L2 compara gx^2+gy^2 com (t+1)^2, o que equivale a
+// (int)sqrt(gx^2+gy^2) > t. L1 e LInf sao triagens mais baratas com LInf <= L2 <= L1.
+inline int magnitudeLimit(MagnitudeMode mode, int threshold) {
+    if (threshold < 0) return 0;
+    return mode == MagnitudeMode::L2 ? (threshold + 1) * (threshold + 1) : threshold + 1;
+}
+
+template <MagnitudeMode M>
+inline int magnitudeMetric(int gx, int gy) {
+    if (M == MagnitudeMode::L2) return gx * gx + gy * gy;
+    int ax = gx < 0 ? -gx : gx;
+    int ay = gy < 0 ? -gy : gy;
+    if (M == MagnitudeMode::L1) return ax + ay;
+    return ax > ay ? ax : ay;
+}
+
+template <class Op, MagnitudeMode M>
+void gradientRange(const uint8_t* b0, const uint8_t* b1, const uint8_t* b2, int from, int to, int limit, uint64_t* out) {
+    for (int x = from; x < to; x++) {
+        int gx = Convolve3x3<typename Op::X>::at(b0, b1, b2, x);
+        int gy = Convolve3x3<typename Op::Y>::at(b0, b1, b2, x);
+
+        uint64_t edge = magnitudeMetric<M>(gx, gy) >= limit;
+        out[x >> 6] |= edge << (x & 63);
+    }
+}
+
+inline void clearMaskRow(int w, uint64_t* out) {
+    for (int i = 0; i < (w + 63) / 64; i++) out[i] = 0;
+}
+
+template <class Op, MagnitudeMode M>
+void gradientRowScalar(const uint8_t* b0, const uint8_t* b1, const uint8_t* b2, int w, int threshold, uint64_t* out) {
+    clearMaskRow(w, out);
+    gradientRange<Op, M>(b0, b1, b2, 1, w - 1, magnitudeLimit(M, threshold), out);
+}
+
+// floor(sqrt(v)) bit a bit, sem ponto flutuante; igual a (int)std::sqrt(v) para qualquer v >= 0.
+inline int isqrt(uint32_t v) {
+    uint32_t root = 0;
+    for (uint32_t bit = 1u << 30; bit; bit >>= 2) {
+        if (v >= root + bit) {
+            v -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+    }
+    return (int)root;
+}
+
+// Magnitude verdadeira, so calculada quando alguem pede a saida de magnitude.
+template <class Op>
+void magnitudeRowScalar(const uint8_t* b0, const uint8_t* b1, const uint8_t* b2, int w, uint16_t* out) {
+    for (int x = 1; x < w - 1; x++) {
+        int gx = Convolve3x3<typename Op::X>::at(b0, b1, b2, x);
+        int gy = Convolve3x3<typename Op::Y>::at(b0, b1, b2, x);
+        out[x] = (uint16_t)isqrt(gx*gx + gy*gy);
+    }
+}
+
+// Nivel de 8 bits da metrica (ver levelRow): so shift e saturacao, sem raiz.
+template <MagnitudeMode M>
+inline uint8_t magnitudeLevel(int metric) {
+    int level = metric >> (M == MagnitudeMode::L2 ? kLevelShiftL2 : 2);
+    return (uint8_t)(level < 255 ? level : 255);
+}
+
+template <class Op, MagnitudeMode M>
+void levelRange(const uint8_t* b0, const uint8_t* b1, const uint8_t* b2, int from, int to, uint8_t* out) {
+    for (int x = from; x < to; x++) {
+        int gx = Convolve3x3<typename Op::X>::at(b0, b1, b2, x);
+        int gy = Convolve3x3<typename Op::Y>::at(b0, b1, b2, x);
+        out[x] = magnitudeLevel<M>(magnitudeMetric<M>(gx, gy));
+    }
+}
+
+template <class Op, MagnitudeMode M>
+void levelRowScalar(const uint8_t* b0, const uint8_t* b1, const uint8_t* b2, int w, uint8_t* out) {
+    out[0] = 0;
+    out[w - 1] = 0;
+    levelRange<Op, M>(b0, b1, b2, 1, w - 1, out);
+}
+
+inline void countLevelRange(const uint8_t* levels, int from, int to, uint32_t* histogram) {
+    for (int i = from; i < to; i++) histogram[(i & 3) * 256 + levels[i]]++;
+}
+
+void levelHistogramScalar(const uint8_t* levels, int n, uint32_t* histogram) {
+    countLevelRange(levels, 0, n, histogram);
+}
+
+// Bits das colunas [from, w) de levels > level; as palavras a partir de from / 64 sao sobrescritas.
+inline void thresholdRange(const uint8_t* levels, int from, int w, int level, uint64_t* out) {
+    for (int i = from / 64; i < (w + 63) / 64; i++) {
+        int n = std::min(64, w - i * 64);
+        const uint8_t* p = levels + i * 64;
+        uint64_t word = 0;
+        for (int b = 0; b < n; b++) word |= (uint64_t)(p[b] > level) << b;
+        out[i] = word;
+    }
+}
+
+void thresholdRowScalar(const uint8_t* levels, int w, int level, uint64_t* out) {
+    thresholdRange(levels, 0, w, level, out);
+}
+
+// Percorre so os bits ligados (ctz) e recalcula gx, gy desses pixels; as tres linhas borradas
+// ainda estao no L1, entao o histograma sai no mesmo passo da mascara. Escalar em todas as tabelas.
+template <class Op>
+void orientationRowScalar(const uint8_t* b0, const uint8_t* b1, const uint8_t* b2, const uint64_t* mask, int w, uint64_t* bins) {
+    for (int i = 0; i < (w + 63) / 64; i++) {
+        for (uint64_t word = mask[i]; word; word &= word - 1) {
+            int x = i * 64 + __builtin_ctzll(word);
+            int gx = Convolve3x3<typename Op::X>::at(b0, b1, b2, x);
+            int gy = Convolve3x3<typename Op::Y>::at(b0, b1, b2, x);
+            bins[orientationBin(gx, gy)] += magnitudeMetric<MagnitudeMode::L1>(gx, gy);
+        }
+    }
+}
+
+#ifdef EDGE_KERNELS_X86
+
+// ---------------- SSE2: 16 pixels por iteracao ----------------
+
+inline __m128i blur8SSE2(__m128i a0, __m128i a1, __m128i a2,
+                         __m128i r0, __m128i r1, __m128i r2,
+                         __m128i c0, __m128i c1, __m128i c2) {
+    __m128i s = _mm_add_epi16(_mm_add_epi16(a0, a2), _mm_add_epi16(c0, c2));
+    s = _mm_add_epi16(s, _mm_slli_epi16(_mm_add_epi16(_mm_add_epi16(a1, c1), _mm_add_epi16(r0, r2)), 1));
+    s = _mm_add_epi16(s, _mm_slli_epi16(r1, 2));
+    return _mm_srli_epi16(s, 4);
+}
+
+void blurRowSSE2(const uint8_t* above, const uint8_t* row, const uint8_t* below, int w, uint8_t* out) {
+    blurBorderColumns(above, row, below, w, out);
+    const __m128i zero = _mm_setzero_si128();
+    int x = 1;
+    for (; x + 16 <= w - 1; x += 16) {
+        __m128i a0 = _mm_loadu_si128((const __m128i*)(above + x - 1));
+        __m128i a1 = _mm_loadu_si128((const __m128i*)(above + x));
+        __m128i a2 = _mm_loadu_si128((const __m128i*)(above + x + 1));
+        __m128i r0 = _mm_loadu_si128((const __m128i*)(row + x - 1));
+        __m128i r1 = _mm_loadu_si128((const __m128i*)(row + x));
+        __m128i r2 = _mm_loadu_si128((const __m128i*)(row + x + 1));
+        __m128i c0 = _mm_loadu_si128((const __m128i*)(below + x - 1));
+        __m128i c1 = _mm_loadu_si128((const __m128i*)(below + x));
+        __m128i c2 = _mm_loadu_si128((const __m128i*)(below + x + 1));
+
+        __m128i lo = blur8SSE2(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(a2, zero),
+                               _mm_unpacklo_epi8(r0, zero), _mm_unpacklo_epi8(r1, zero), _mm_unpacklo_epi8(r2, zero),
+                               _mm_unpacklo_epi8(c0, zero), _mm_unpacklo_epi8(c1, zero), _mm_unpacklo_epi8(c2, zero));
+        __m128i hi = blur8SSE2(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(a2, zero),
+                               _mm_unpackhi_epi8(r0, zero), _mm_unpackhi_epi8(r1, zero), _mm_unpackhi_epi8(r2, zero),
+                               _mm_unpackhi_epi8(c0, zero), _mm_unpackhi_epi8(c1, zero), _mm_unpackhi_epi8(c2, zero));
+        _mm_storeu_si128((__m128i*)(out + x), _mm_packus_epi16(lo, hi));
+    }
+    for (; x < w - 1; x++) {
+        int sum = above[x-1] + above[x] * 2 + above[x+1]
+                + row[x-1] * 2 + row[x] * 4 + row[x+1] * 2
+                + below[x-1] + below[x] * 2 + below[x+1];
+        out[x] = sum / 16;
+    }
+}
+
+// Grava 16 bits de borda (pixels x..x+15) na linha da mascara, que pode cruzar duas palavras.
+inline void depositMask16(uint64_t* out, int x, unsigned bits) {
+    int shift = x & 63;
+    out[x >> 6] |= (uint64_t)bits << shift;
+    if (shift > 48) out[(x >> 6) + 1] |= (uint64_t)bits >> (64 - shift);
+}
+
+// Limite - 1 saturado em int16, para as comparacoes L1/LInf (a metrica nunca passa de 2040).
+inline int limitMinus1Int16(int limit) {
+    return limit - 1 > 32767 ? 32767 : limit - 1;
+}
+
+// Mascara (0xFFFF por pixel) de metrica >= limit para 8 pixels em int16.
+// limit32 e usado pelo L2 (gx^2+gy^2 em 32 bits), limit16 pelo L1/LInf.
+template <MagnitudeMode M>
+inline __m128i edgeMask8SSE2(__m128i gx, __m128i gy, __m128i limit32, __m128i limit16) {
+    if (M == MagnitudeMode::L2) {
+        __m128i sLo = _mm_madd_epi16(_mm_unpacklo_epi16(gx, gy), _mm_unpacklo_epi16(gx, gy));
+        __m128i sHi = _mm_madd_epi16(_mm_unpackhi_epi16(gx, gy), _mm_unpackhi_epi16(gx, gy));
+        return _mm_packs_epi32(_mm_cmpgt_epi32(sLo, limit32), _mm_cmpgt_epi32(sHi, limit32));
+    }
+    const __m128i zero = _mm_setzero_si128();
+    __m128i ax = _mm_max_epi16(gx, _mm_sub_epi16(zero, gx));
+    __m128i ay = _mm_max_epi16(gy, _mm_sub_epi16(zero, gy));
+    __m128i m = M == MagnitudeMode::L1 ? _mm_add_epi16(ax, ay) : _mm_max_epi16(ax, ay);
+    return _mm_cmpgt_epi16(m, limit16);
+}
+
+// acc + C * v em int16, com C constante: peso 0 nao soma, +-1 e +-2 sem multiplicacao.
+template <int C>
+inline __m128i accumulateSSE2(__m128i acc, __m128i v) {
+    if constexpr (C == 0) return acc;
+    else if constexpr (C == 1) return _mm_add_epi16(acc, v);
+    else if constexpr (C == -1) return _mm_sub_epi16(acc, v);
+    else if constexpr (C == 2) return _mm_add_epi16(acc, _mm_slli_epi16(v, 1));
+    else if constexpr (C == -2) return _mm_sub_epi16(acc, _mm_slli_epi16(v, 1));
+    else return _mm_add_epi16(acc, _mm_mullo_epi16(v, _mm_set1_epi16((short)C)));
+}
+
+// Resposta do kernel K (Convolve3x3) em 8 pixels; n[linha][coluna] sao os vizinhos em int16,
+// coluna 0 = x-1. Kernel separavel: somas verticais so das colunas com peso horizontal != 0.
+// Vizinhos que nenhum tap usa nem chegam a ser carregados (o compilador descarta a carga).
+template <class K>
+inline __m128i convolve8SSE2(const __m128i (&n)[3][3]) {
+    typedef Convolve3x3<K> C;
+    __m128i acc = _mm_setzero_si128();
+    if constexpr (C::separable) {
+        constexpr conv3x3::Factors f = C::factors;
+        __m128i cols[3];
+        for (int c = 0; c < 3; c++) {
+            cols[c] = accumulateSSE2<f.col[0]>(_mm_setzero_si128(), n[0][c]);
+            cols[c] = accumulateSSE2<f.col[1]>(cols[c], n[1][c]);
+            cols[c] = accumulateSSE2<f.col[2]>(cols[c], n[2][c]);
+        }
+        acc = accumulateSSE2<f.row[0]>(acc, cols[0]);
+        acc = accumulateSSE2<f.row[1]>(acc, cols[1]);
+        acc = accumulateSSE2<f.row[2]>(acc, cols[2]);
+    } else {
+        acc = accumulateSSE2<K::taps[0][0]>(acc, n[0][0]);
+        acc = accumulateSSE2<K::taps[0][1]>(acc, n[0][1]);
+        acc = accumulateSSE2<K::taps[0][2]>(acc, n[0][2]);
+        acc = accumulateSSE2<K::taps[1][0]>(acc, n[1][0]);
+        acc = accumulateSSE2<K::taps[1][1]>(acc, n[1][1]);
+        acc = accumulateSSE2<K::taps[1][2]>(acc, n[1][2]);
+        acc = accumulateSSE2<K::taps[2][0]>(acc, n[2][0]);
+        acc = accumulateSSE2<K::taps[2][1]>(acc, n[2][1]);
+        acc = accumulateSSE2<K::taps[2][2]>(acc, n[2][2]);
+    }
+    return acc;
+}
+
+// gx, gy de 16 pixels (x..x+15) do operador Op, em duas metades de 8 (lo = x..x+7).
+// Em int16 sem estouro: o maior ganho (Scharr, 16 x 255) cabe com folga.
+template <class Op>
+inline void gradient16SSE2(const uint8_t* b0, const uint8_t* b1, const uint8_t* b2, int x,
+                           __m128i gx[2], __m128i gy[2]) {
+    const __m128i zero = _mm_setzero_si128();
+    const uint8_t* rows[3] = { b0, b1, b2 };
+    __m128i lo[3][3], hi[3][3];
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 3; c++) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(rows[r] + x + c - 1));
+            lo[r][c] = _mm_unpacklo_epi8(v, zero);
+            hi[r][c] = _mm_unpackhi_epi8(v, zero);
+        }
+    }
+    gx[0] = convolve8SSE2<typename Op::X>(lo);
+    gy[0] = convolve8SSE2<typename Op::Y>(lo);
+    gx[1] = convolve8SSE2<typename Op::X>(hi);
+    gy[1] = convolve8SSE2<typename Op::Y>(hi);
+}
+
+template <class Op, MagnitudeMode M>
+void gradientRowSSE2(const uint8_t* b0, const uint8_t* b1, const uint8_t* b2, int w, int threshold, uint64_t* out) {
+    const int limit = magnitudeLimit(M, threshold);
+    const __m128i limit32 = _mm_set1_epi32(limit - 1);
+    const __m128i limit16 = _mm_set1_epi16((short)limitMinus1Int16(limit));
+    clearMaskRow(w, out);
+    int x = 1;
+    for (; x + 16 <= w - 1; x += 16) {
+        __m128i gx[2], gy[2];
+        gradient16SSE2<Op>(b0, b1, b2, x, gx, gy);
+        __m128i maskLo = edgeMask8SSE2<M>(gx[0], gy[0], limit32, limit16);
+        __m128i maskHi = edgeMask8SSE2<M>(gx[1], gy[1], limit32, limit16);
+        depositMask16(out, x, _mm_movemask_epi8(_mm_packs_epi16(maskLo, maskHi)));
+    }
+    gradientRange<Op, M>(b0, b1, b2, x, w - 1, limit, out);
+}
+
+// Niveis (int16) de 8 pixels; o packus de quem chama satura em 255.
+template <MagnitudeMode M>
+inline __m128i level8SSE2(__m128i gx, __m128i gy) {
+    if (M == MagnitudeMode::L2) {
+        __m128i sLo = _mm_madd_epi16(_mm_unpacklo_epi16(gx, gy), _mm_unpacklo_epi16(gx, gy));
+        __m128i sHi = _mm_madd_epi16(_mm_unpackhi_epi16(gx, gy), _mm_unpackhi_epi16(gx, gy));
+        return _mm_packs_epi32(_mm_srli_epi32(sLo, kLevelShiftL2), _mm_srli_epi32(sHi, kLevelShiftL2));
+    }
+    const __m128i zero = _mm_setzero_si128();
+    __m128i ax = _mm_max_epi16(gx, _mm_sub_epi16(zero, gx));
+    __m128i ay = _mm_max_epi16(gy, _mm_sub_epi16(zero, gy));
+    __m128i m = M == MagnitudeMode::L1 ? _mm_add_epi16(ax, ay) : _mm_max_epi16(ax, ay);
+    return _mm_srli_epi16(m, 2);
+}
+
+// Histograma vetorial em blocos de 64 niveis, 63 blocos por rodada (cada bloco soma ate 4 por pista
+// nos contadores de 8 bits). Todo bloco conta os niveis 1 e 2 por comparacao e soma seus niveis; sem
+// niveis >= 4, a soma menos essas contagens da o nivel 3, e o nivel 0 sai do total. O bloco com algum
+// nivel >= 4 entra na fila da rodada, sem desvio: la a soma dele e refeita sem estouro e os >= 4 sao
+// contados um a um pela mascara e tirados da soma.
+constexpr int kHistogramBlocks = 63;
+
+// Conta os niveis >= 4 de um bloco da fila (bits: um por pixel, nunca zero); devolve a soma deles.
+// Sao poucos e espalhados, entao vao todos para a primeira copia do histograma.
+inline uint32_t countHighLevels(const uint8_t* block, uint64_t bits, uint32_t* histogram, uint32_t& high) {
+    uint32_t sum = 0;
+    do {
+        int k = __builtin_ctzll(bits);
+        histogram[block[k]]++;
+        sum += block[k];
+        high++;
+        bits &= bits - 1;
+    } while (bits);
+    return sum;
+}
+
+// Fecha uma rodada de pixels niveis: ones/twos contam todos os blocos, sum e a soma exata dos niveis
+// 1..3 e high os >= 4 ja contados.
+inline void finishLevelRound(int pixels, uint32_t ones, uint32_t twos, uint64_t sum, uint32_t high, uint32_t* histogram) {
+    uint32_t threes = (uint32_t)((sum - ones - 2 * (uint64_t)twos) / 3);
+    histogram[1] += ones;
+    histogram[2] += twos;
+    histogram[3] += threes;
+    histogram[0] += (uint32_t)pixels - ones - twos - threes - high;
+}
+
+inline uint32_t sumBytesSSE2(__m128i v) {
+    __m128i sums = _mm_sad_epu8(v, _mm_setzero_si128());
+    return (uint32_t)(_mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(sums, sums)));
+}
+
+// Soma dos 64 niveis do bloco em duas pistas de 64 bits: somar os bytes antes do psadbw so e exato
+// com niveis 0..3, entao a fila troca essa soma pela exata.
+inline __m128i blockSumSSE2(const __m128i (&v)[4]) {
+    __m128i t = _mm_add_epi8(_mm_add_epi8(v[0], v[1]), _mm_add_epi8(v[2], v[3]));
+    return _mm_sad_epu8(t, _mm_setzero_si128());
+}
+
+void levelHistogramSSE2(const uint8_t* levels, int n, uint32_t* histogram) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i two = _mm_set1_epi8(2);
+    const __m128i above3 = _mm_set1_epi8(0x7C);   // soma saturada: nivel >= 4 liga o bit 7
+    int pending[kHistogramBlocks];
+    int i = 0;
+    while (i + 64 <= n) {
+        __m128i ones = zero, twos = zero, sum = zero;
+        int start = i;
+        int end = std::min(n, i + kHistogramBlocks * 64);
+        int pendingCount = 0;
+        for (; i + 64 <= end; i += 64) {
+            __m128i v[4];
+            for (int j = 0; j < 4; j++) {
+                v[j] = _mm_loadu_si128((const __m128i*)(levels + i + 16 * j));
+                ones = _mm_sub_epi8(ones, _mm_cmpeq_epi8(v[j], one));
+                twos = _mm_sub_epi8(twos, _mm_cmpeq_epi8(v[j], two));
+            }
+            sum = _mm_add_epi64(sum, blockSumSSE2(v));
+            __m128i any = _mm_or_si128(_mm_or_si128(v[0], v[1]), _mm_or_si128(v[2], v[3]));
+            pending[pendingCount] = i - start;
+            pendingCount += _mm_movemask_epi8(_mm_adds_epu8(any, above3)) != 0;
+        }
+
+        uint32_t high = 0;
+        uint64_t highSum = 0;
+        for (int p = 0; p < pendingCount; p++) {
+            int b = pending[p];
+            __m128i v[4];
+            uint64_t bits = 0;
+            for (int j = 0; j < 4; j++) {
+                v[j] = _mm_loadu_si128((const __m128i*)(levels + start + b + 16 * j));
+                sum = _mm_add_epi64(sum, _mm_sad_epu8(v[j], zero));
+                bits |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_adds_epu8(v[j], above3)) << (16 * j);
+            }
+            sum = _mm_sub_epi64(sum, blockSumSSE2(v));
+            highSum += countHighLevels(levels + start + b, bits, histogram, high);
+        }
+
+        uint64_t total = (uint64_t)_mm_cvtsi128_si64(sum) + (uint64_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(sum, sum));
+        finishLevelRound(i - start, sumBytesSSE2(ones), sumBytesSSE2(twos), total - highSum, high, histogram);
+    }
+    countLevelRange(levels, i, n, histogram);
+}
+
+template <class Op, MagnitudeMode M>
+void levelRowSSE2(const uint8_t* b0, const uint8_t* b1, const uint8_t* b2, int w, uint8_t* out) {
+    out[0] = 0;
+    out[w - 1] = 0;
+    int x = 1;
+    for (; x + 16 <= w - 1; x += 16) {
+        __m128i gx[2], gy[2];
+        gradient16SSE2<Op>(b0, b1, b2, x, gx, gy);
+        // packus satura em 255, o mesmo corte do nivel escalar.
+        __m128i levels = _mm_packus_epi16(level8SSE2<M>(gx[0], gy[0]), level8SSE2<M>(gx[1], gy[1]));
+        _mm_storeu_si128((__m128i*)(out + x), levels);
+    }
+    levelRange<Op, M>(b0, b1, b2, x, w - 1, out);
+}
+
+// levels > level sem comparacao com sinal: max(v, level + 1) == v.
+void thresholdRowSSE2(const uint8_t* levels, int w, int level, uint64_t* out) {
+    if (level >= 255) {
+        clearMaskRow(w, out);
+        return;
+    }
+    const __m128i bound = _mm_set1_epi8((char)(level + 1));
+    int i = 0;
+    for (; (i + 1) * 64 <= w; i++) {
+        uint64_t word = 0;
+        for (int k = 0; k < 4; k++) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(levels + i * 64 + k * 16));
+            uint64_t bits = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(v, bound), v));
+            word |= bits << (k * 16);
+        }
+        out[i] = word;
+    }
+    thresholdRange(levels, i * 64, w, level, out);
+}
+
+// ---------------- AVX2: 16 pixels por iteracao em registradores de 256 bits ----------------
+
+__attribute__((target("avx2")))
+inline __m256i load16AVX2(const uint8_t* p) {
+    return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)p));
+}
+
+__attribute__((target("avx2")))
+inline __m128i narrow16AVX2(__m256i v) {
+    return _mm_packus_epi16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+}
+
+__attribute__((target("avx2")))
+void blurRowAVX2(const uint8_t* above, const uint8_t* row, const uint8_t* below, int w, uint8_t* out) {
+    blurBorderColumns(above, row, below, w, out);
+    int x = 1;
+    for (; x + 16 <= w - 1; x += 16) {
+        __m256i s = _mm256_add_epi16(_mm256_add_epi16(load16AVX2(above + x - 1), load16AVX2(above + x + 1)),
+                                     _mm256_add_epi16(load16AVX2(below + x - 1), load16AVX2(below + x + 1)));
+        __m256i e = _mm256_add_epi16(_mm256_add_epi16(load16AVX2(above + x), load16AVX2(below + x)),
+                                     _mm256_add_epi16(load16AVX2(row + x - 1), load16AVX2(row + x + 1)));
+        s = _mm256_add_epi16(s, _mm256_slli_epi16(e, 1));
+        s = _mm256_add_epi16(s, _mm256_slli_epi16(load16AVX2(row + x), 2));
+        _mm_storeu_si128((__m128i*)(out + x), narrow16AVX2(_mm256_srli_epi16(s, 4)));
+    }
+    for (; x < w - 1; x++) {
+        int sum = above[x-1] + above[x] * 2 + above[x+1]
+                + row[x-1] * 2 + row[x] * 4 + row[x+1] * 2
+                + below[x-1] + below[x] * 2 + below[x+1];
+        out[x] = sum / 16;
+    }
+}
+
+template <int C>
+__attribute__((target("avx2")))
+inline __m256i accumulateAVX2(__m256i acc, __m256i v) {
+    if constexpr (C == 0) return acc;
+    else if constexpr (C == 1) return _mm256_add_epi16(acc, v);
+    else if constexpr (C == -1) return _mm256_sub_epi16(acc, v);
+    else if constexpr (C == 2) return _mm256_add_epi16(acc, _mm256_slli_epi16(v, 1));
+    else if constexpr (C == -2) return _mm256_sub_epi16(acc, _mm256_slli_epi16(v, 1));
+    else return _mm256_add_epi16(acc, _mm256_mullo_epi16(v, _mm256_set1_epi16((short)C)));
+}
+
+// Como convolve8SSE2, com 16 pixels por registrador.
+template <class K>
+__attribute__((target("avx2")))
+inline __m256i convolve16AVX2(const __m256i (&n)[3][3]) {
+    typedef Convolve3x3<K> C;
+    __m256i acc = _mm256_setzero_si256();
+    if constexpr (C::separable) {
+        constexpr conv3x3::Factors f = C::factors;
+        __m256i cols[3];
+        for (int c = 0; c < 3; c++) {
+            cols[c] = accumulateAVX2<f.col[0]>(_mm256_setzero_si256(), n[0][c]);
+            cols[c] = accumulateAVX2<f.col[1]>(cols[c], n[1][c]);
+            cols[c] = accumulateAVX2<f.col[2]>(cols[c], n[2][c]);
+        }
+        acc = accumulateAVX2<f.row[0]>(acc, cols[0]);
+        acc = accumulateAVX2<f.row[1]>(acc, cols[1]);
+        acc = accumulateAVX2<f.row[2]>(acc, cols[2]);
+    } else {
+        acc = accumulateAVX2<K::taps[0][0]>(acc, n[0][0]);
+        acc = accumulateAVX2<K::taps[0][1]>(acc, n[0][1]);
+        acc = accumulateAVX2<K::taps[0][2]>(acc, n[0][2]);
+        acc = accumulateAVX2<K::taps[1][0]>(acc, n[1][0]);
+        acc = accumulateAVX2<K::taps[1][1]>(acc, n[1][1]);
+        acc = accumulateAVX2<K::taps[1][2]>(acc, n[1][2]);
+        acc = accumulateAVX2<K::taps[2][0]>(acc, n[2][0]);
+        acc = accumulateAVX2<K::taps[2][1]>(acc, n[2][1]);
+        acc = accumulateAVX2<K::taps[2][2]>(acc, n[2][2]);
+    }
+    return acc;
+}
+
+template <class Op>
+__attribute__((target("avx2")))
+inline void gradient16AVX2(const uint8_t* b0, const uint8_t* b1, const uint8_t* b2, int x, __m256i& gx, __m256i& gy) {
+    const uint8_t* rows[3] = { b0, b1, b2 };
+    __m256i n[3][3];
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 3; c++) n[r][c] = load16AVX2(rows[r] + x + c - 1);
+    }
+    gx = convolve16AVX2<typename Op::X>(n);
+    gy = convolve16AVX2<typename Op::Y>(n);
+}
+
+template <class Op, MagnitudeMode M>
+__attribute__((target("avx2")))
+void gradientRowAVX2(const uint8_t* b0, const uint8_t* b1, const uint8_t* b2, int w, int threshold, uint64_t* out) {
+    const int limit = magnitudeLimit(M, threshold);
+    const __m256i limit32 = _mm256_set1_epi32(limit - 1);
+    const __m256i limit16 = _mm256_set1_epi16((short)limitMinus1Int16(limit));
+    clearMaskRow(w, out);
+    int x = 1;
+    for (; x + 16 <= w - 1; x += 16) {
+        __m256i gx, gy;
+        gradient16AVX2<Op>(b0, b1, b2, x, gx, gy);
+
+        __m256i mask16;
+        if (M == MagnitudeMode::L2) {
+            // unpack opera por lane de 128 bits; o packs_epi32 logo abaixo devolve a ordem original.
+            __m256i lo = _mm256_unpacklo_epi16(gx, gy);
+            __m256i hi = _mm256_unpackhi_epi16(gx, gy);
+            __m256i sLo = _mm256_madd_epi16(lo, lo);
+            __m256i sHi = _mm256_madd_epi16(hi, hi);
+            mask16 = _mm256_packs_epi32(_mm256_cmpgt_epi32(sLo, limit32), _mm256_cmpgt_epi32(sHi, limit32));
+        } else {
+            __m256i ax = _mm256_abs_epi16(gx);
+            __m256i ay = _mm256_abs_epi16(gy);
+            __m256i m = M == MagnitudeMode::L1 ? _mm256_add_epi16(ax, ay) : _mm256_max_epi16(ax, ay);
+            mask16 = _mm256_cmpgt_epi16(m, limit16);
+        }
+
+        __m128i mask = _mm_packs_epi16(_mm256_castsi256_si128(mask16), _mm256_extracti128_si256(mask16, 1));
+        depositMask16(out, x, _mm_movemask_epi8(mask));
+    }
+    gradientRange<Op, M>(b0, b1, b2, x, w - 1, limit, out);
+}
+
+template <class Op, MagnitudeMode M>
+__attribute__((target("avx2")))
+void levelRowAVX2(const uint8_t* b0, const uint8_t* b1, const uint8_t* b2, int w, uint8_t* out) {
+    out[0] = 0;
+    out[w - 1] = 0;
+    int x = 1;
+    for (; x + 16 <= w - 1; x += 16) {
+        __m256i gx, gy;
+        gradient16AVX2<Op>(b0, b1, b2, x, gx, gy);
+
+        __m256i level16;
+        if (M == MagnitudeMode::L2) {
+            // packs_epi32 devolve a ordem original dos pixels.
+            __m256i lo = _mm256_unpacklo_epi16(gx, gy);
+            __m256i hi = _mm256_unpackhi_epi16(gx, gy);
+            level16 = _mm256_packs_epi32(_mm256_srli_epi32(_mm256_madd_epi16(lo, lo), kLevelShiftL2),
+                                         _mm256_srli_epi32(_mm256_madd_epi16(hi, hi), kLevelShiftL2));
+        } else {
+            __m256i ax = _mm256_abs_epi16(gx);
+            __m256i ay = _mm256_abs_epi16(gy);
+            __m256i m = M == MagnitudeMode::L1 ? _mm256_add_epi16(ax, ay) : _mm256_max_epi16(ax, ay);
+            level16 = _mm256_srli_epi16(m, 2);
+        }
+        __m128i levels = narrow16AVX2(level16);
+        _mm_storeu_si128((__m128i*)(out + x), levels);
+    }
+    levelRange<Op, M>(b0, b1, b2, x, w - 1, out);
+}
+
+// Mesmo esquema do levelHistogramSSE2, com dois vetores de 32 niveis por bloco.
+__attribute__((target("avx2")))
+inline uint32_t sumBytesAVX2(__m256i v) {
+    __m256i sums = _mm256_sad_epu8(v, _mm256_setzero_si256());
+    __m128i s = _mm_add_epi64(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+    return (uint32_t)(_mm_cvtsi128_si32(s) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(s, s)));
+}
+
+__attribute__((target("avx2")))
+inline __m256i blockSumAVX2(const __m256i (&v)[2]) {
+    return _mm256_sad_epu8(_mm256_add_epi8(v[0], v[1]), _mm256_setzero_si256());
+}
+
+__attribute__((target("avx2")))
+void levelHistogramAVX2(const uint8_t* levels, int n, uint32_t* histogram) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi8(1);
+    const __m256i two = _mm256_set1_epi8(2);
+    const __m256i above3 = _mm256_set1_epi8((char)0xFC);
+    const __m256i saturate3 = _mm256_set1_epi8(0x7C);   // soma saturada: nivel >= 4 liga o bit 7
+    int pending[kHistogramBlocks];
+    int i = 0;
+    while (i + 64 <= n) {
+        __m256i ones = zero, twos = zero, sum = zero;
+        int start = i;
+        int end = std::min(n, i + kHistogramBlocks * 64);
+        int pendingCount = 0;
+        for (; i + 64 <= end; i += 64) {
+            __m256i v[2];
+            for (int j = 0; j < 2; j++) {
+                v[j] = _mm256_loadu_si256((const __m256i*)(levels + i + 32 * j));
+                ones = _mm256_sub_epi8(ones, _mm256_cmpeq_epi8(v[j], one));
+                twos = _mm256_sub_epi8(twos, _mm256_cmpeq_epi8(v[j], two));
+            }
+            sum = _mm256_add_epi64(sum, blockSumAVX2(v));
+            pending[pendingCount] = i - start;
+            pendingCount += !_mm256_testz_si256(_mm256_or_si256(v[0], v[1]), above3);
+        }
+
+        uint32_t high = 0;
+        uint64_t highSum = 0;
+        for (int p = 0; p < pendingCount; p++) {
+            int b = pending[p];
+            __m256i v[2];
+            uint64_t bits = 0;
+            for (int j = 0; j < 2; j++) {
+                v[j] = _mm256_loadu_si256((const __m256i*)(levels + start + b + 32 * j));
+                sum = _mm256_add_epi64(sum, _mm256_sad_epu8(v[j], zero));
+                bits |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_adds_epu8(v[j], saturate3)) << (32 * j);
+            }
+            sum = _mm256_sub_epi64(sum, blockSumAVX2(v));
+            highSum += countHighLevels(levels + start + b, bits, histogram, high);
+        }
+
+        __m128i s = _mm_add_epi64(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        uint64_t total = (uint64_t)_mm_cvtsi128_si64(s) + (uint64_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(s, s));
+        finishLevelRound(i - start, sumBytesAVX2(ones), sumBytesAVX2(twos), total - highSum, high, histogram);
+    }
+    countLevelRange(levels, i, n, histogram);
+}
+
+__attribute__((target("avx2")))
+void thresholdRowAVX2(const uint8_t* levels, int w, int level, uint64_t* out) {
+    if (level >= 255) {
+        clearMaskRow(w, out);
+        return;
+    }
+    const __m256i bound = _mm256_set1_epi8((char)(level + 1));
+    int i = 0;
+    for (; (i + 1) * 64 <= w; i++) {
+        __m256i lo = _mm256_loadu_si256((const __m256i*)(levels + i * 64));
+        __m256i hi = _mm256_loadu_si256((const __m256i*)(levels + i * 64 + 32));
+        uint64_t bitsLo = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(lo, bound), lo));
+        uint64_t bitsHi = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(hi, bound), hi));
+        out[i] = bitsLo | (bitsHi << 32);
+    }
+    thresholdRange(levels, i * 64, w, level, out);
+}
+
+#endif
+
+// Tabelas [operador][metrica]: os tres operadores tem versao SIMD, instanciada dos taps do
+// Convolve3x3. Magnitude verdadeira (sob demanda, com raiz inteira) e orientacao (so nos pixels de
+// borda) sao escalares em todas as tabelas.
+#define EDGE_OP_MODES(fn, Op) { fn<Op, MagnitudeMode::L2>, fn<Op, MagnitudeMode::L1>, fn<Op, MagnitudeMode::LInf> }
+#define EDGE_OPERATORS(fn) { EDGE_OP_MODES(fn, SobelOperator), EDGE_OP_MODES(fn, ScharrOperator), \
+                             EDGE_OP_MODES(fn, PrewittOperator) }
+#define EDGE_MAGNITUDES { magnitudeRowScalar<SobelOperator>, magnitudeRowScalar<ScharrOperator>, \
+                          magnitudeRowScalar<PrewittOperator> }
+#define EDGE_ORIENTATIONS { orientationRowScalar<SobelOperator>, orientationRowScalar<ScharrOperator>, \
+                            orientationRowScalar<PrewittOperator> }
+
+const EdgeKernels kScalar = { KernelIsa::Scalar, "scalar", blurRowScalar,
+                              EDGE_OPERATORS(gradientRowScalar),
+                              EDGE_MAGNITUDES,
+                              EDGE_OPERATORS(levelRowScalar),
+                              levelHistogramScalar,
+                              thresholdRowScalar,
+                              EDGE_ORIENTATIONS };
+#ifdef EDGE_KERNELS_X86
+const EdgeKernels kSSE2 = { KernelIsa::SSE2, "sse2", blurRowSSE2,
+                            EDGE_OPERATORS(gradientRowSSE2),
+                            EDGE_MAGNITUDES,
+                            EDGE_OPERATORS(levelRowSSE2),
+                            levelHistogramSSE2,
+                            thresholdRowSSE2,
+                            EDGE_ORIENTATIONS };
+const EdgeKernels kAVX2 = { KernelIsa::AVX2, "avx2", blurRowAVX2,
+                            EDGE_OPERATORS(gradientRowAVX2),
+                            EDGE_MAGNITUDES,
+                            EDGE_OPERATORS(levelRowAVX2),
+                            levelHistogramAVX2,
+                            thresholdRowAVX2,
+                            EDGE_ORIENTATIONS };
+#endif
+
+}
+
+const EdgeKernels& scalarEdgeKernels() {
+    return kScalar;
+}
+
+const EdgeKernels* edgeKernelsFor(KernelIsa isa) {
+    switch (isa) {
+    case KernelIsa::Scalar:
+        return &kScalar;
+#ifdef EDGE_KERNELS_X86
+    case KernelIsa::SSE2:
+        return __builtin_cpu_supports("sse2") ? &kSSE2 : nullptr;
+    case KernelIsa::AVX2:
+        return __builtin_cpu_supports("avx2") ? &kAVX2 : nullptr;
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+const EdgeKernels& bestEdgeKernels() {
+    static const EdgeKernels* best = [] {
+        const EdgeKernels* k = edgeKernelsFor(KernelIsa::AVX2);
+        if (!k) k = edgeKernelsFor(KernelIsa::SSE2);
+        if (!k) k = &kScalar;
+        return k;
+    }();
+    return *best;
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <cstdint>
+
+enum class KernelIsa {
+    Scalar,
+    SSE2,
+    AVX2
+};
+
+// Metrica de magnitude do gradiente usada na decisao de borda (sempre em inteiro, sem sqrt).
+// L2 e exato; L1 (|gx|+|gy|) e LInf (max(|gx|,|gy|)) sao triagens mais baratas,
+// com LInf <= L2 <= L1: L1 nunca perde uma borda do L2 e LInf nunca inventa uma.
+enum class MagnitudeMode {
+    L2,
+    L1,
+    LInf
+};
+
+// Operador de gradiente 3x3 (ver Convolve3x3.h). O limiar e na escala do operador:
+// Scharr responde ~4x mais que o Sobel, Prewitt ~3/4.
+enum class GradientOperator {
+    Sobel,
+    Scharr,
+    Prewitt
+};
+
+// Kernels de uma linha usados pelo EdgeProcessor.
+// blurRow: Gaussiano 3x3 (1-2-1) das linhas above/row/below, escreve out[0..w-1] (w >= 3).
+//          As colunas 0 e w-1 replicam a borda; o clamp em y e de quem chama, ao escolher above/below.
+// gradientRow: gradiente sobre tres linhas borradas, escreve a linha da mascara de bits (ver EdgeMask):
+//              bit x ligado para borda em x, colunas 0 e w-1 sempre desligadas.
+// magnitudeRow: magnitude verdadeira (int)sqrt(gx^2+gy^2) em out[1..w-2].
+// levelRow: nivel de 8 bits da metrica em out[1..w-2] (out[0] = out[w-1] = 0), sem raiz:
+//           L2 min((gx^2+gy^2) >> kLevelShiftL2, 255), L1/LInf min(metrica >> 2, 255).
+//           nivel > k equivale a metrica >= (k+1) << shift, entao a mascara desse limite sai
+//           exata dos niveis; e o buffer compacto do limiar adaptativo.
+// levelHistogram: conta levels[0..n-1] em histogram (4 copias de 256 contadores, somadas por quem
+//                 chama; a divisao entre as copias muda com o kernel, so a soma e exata).
+// thresholdRow: linha da mascara com o bit x ligado quando levels[x] > level (x em [0, w)).
+// orientationRow: para cada bit ligado em mask (as bordas ja decididas da linha), soma |gx|+|gy|
+//                 em bins[orientationBin(gx, gy)]; o custo e so o dos pixels de borda.
+constexpr int kLevelShiftL2 = 10;   // nivel 1 = magnitude 32, 255 = magnitude 511
+constexpr int kOrientationBins = 16;
+
+// Bin da direcao da borda (perpendicular ao gradiente): 16 bins de 11.25 graus centrados em
+// k * 11.25, de 0 = borda horizontal a 8 = vertical, com o angulo crescendo de +x para +y (y para baixo).
+// Sem atan: o gradiente e dobrado para gy >= 0 pelos sinais, |gx| x |gy| separa o octante e a
+// razao menor/maior e comparada com tan(5.625), tan(16.875), tan(28.125) e tan(39.375) em Q16.
+inline int orientationBin(int gx, int gy) {
+    if (gy < 0 || (gy == 0 && gx < 0)) {
+        gx = -gx;
+        gy = -gy;
+    }
+    bool mirrored = gx < 0;
+    uint32_t ax = mirrored ? -gx : gx;
+    uint32_t ay = gy;
+    uint32_t lo = ax < ay ? ax : ay;
+    uint32_t hi = ax < ay ? ay : ax;
+    uint32_t ratio = lo << 16;
+    int steps = (int)(ratio >= 6455u * hi) + (int)(ratio >= 19880u * hi)
+              + (int)(ratio >= 35030u * hi) + (int)(ratio >= 53784u * hi);
+    int bin = ay <= ax ? steps : 8 - steps;   // angulo do gradiente em [0, 90]
+    if (mirrored) bin = 16 - bin;             // (90, 180), com 180 = 0
+    return (bin + 8) & 15;
+}
+
+typedef void (*BlurRowFn)(const uint8_t* above, const uint8_t* row, const uint8_t* below, int w, uint8_t* out);
+typedef void (*GradientRowFn)(const uint8_t* b0, const uint8_t* b1, const uint8_t* b2, int w, int threshold, uint64_t* out);
+typedef void (*MagnitudeRowFn)(const uint8_t* b0, const uint8_t* b1, const uint8_t* b2, int w, uint16_t* out);
+typedef void (*LevelRowFn)(const uint8_t* b0, const uint8_t* b1, const uint8_t* b2, int w, uint8_t* out);
+typedef void (*LevelHistogramFn)(const uint8_t* levels, int n, uint32_t* histogram);
+typedef void (*ThresholdRowFn)(const uint8_t* levels, int w, int level, uint64_t* out);
+typedef void (*OrientationRowFn)(const uint8_t* b0, const uint8_t* b1, const uint8_t* b2, const uint64_t* mask, int w, uint64_t* bins);
+
+struct EdgeKernels {
+    KernelIsa isa;
+    const char* name;
+    BlurRowFn blurRow;
+    GradientRowFn gradientRow[3][3];   // [GradientOperator][MagnitudeMode]
+    MagnitudeRowFn magnitudeRow[3];    // [GradientOperator]
+    LevelRowFn levelRow[3][3];         // [GradientOperator][MagnitudeMode]
+    LevelHistogramFn levelHistogram;
+    ThresholdRowFn thresholdRow;
+    OrientationRowFn orientationRow[3];   // [GradientOperator]
+
+    GradientRowFn gradientFor(GradientOperator op, MagnitudeMode mode) const { return gradientRow[(int)op][(int)mode]; }
+    MagnitudeRowFn magnitudeFor(GradientOperator op) const { return magnitudeRow[(int)op]; }
+    LevelRowFn levelFor(GradientOperator op, MagnitudeMode mode) const { return levelRow[(int)op][(int)mode]; }
+    OrientationRowFn orientationFor(GradientOperator op) const { return orientationRow[(int)op]; }
+};
+
+// Implementacao escalar: e a referencia contra a qual as versoes SIMD sao validadas.
+const EdgeKernels& scalarEdgeKernels();
+
+// Devolve nullptr se o build ou a CPU atual nao suportam o conjunto pedido.
+const EdgeKernels* edgeKernelsFor(KernelIsa isa);
+
+// Melhor conjunto disponivel na CPU atual (detectado uma vez, em tempo de execucao).
+const EdgeKernels& bestEdgeKernels();
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Mascara de bordas compacta: 1 bit por pixel, linhas alinhadas em palavras de 64 bits.
+// O pixel x da linha y fica no bit (x % 64) da palavra y * wordsPerRow + x / 64.
+struct EdgeMask {
+    int width = 0;
+    int height = 0;
+    int wordsPerRow = 0;
+    std::vector<uint64_t> bits;
+
+    EdgeMask() = default;
+    EdgeMask(int w, int h) { reset(w, h); }
+
+    void reset(int w, int h) {
+        width = w;
+        height = h;
+        wordsPerRow = (w + 63) / 64;
+        bits.assign((size_t)wordsPerRow * h, 0);
+    }
+
+    uint64_t* row(int y) { return bits.data() + (size_t)y * wordsPerRow; }
+    const uint64_t* row(int y) const { return bits.data() + (size_t)y * wordsPerRow; }
+
+    bool get(int x, int y) const { return (row(y)[x >> 6] >> (x & 63)) & 1; }
+
+    void set(int x, int y) { row(y)[x >> 6] |= 1ull << (x & 63); }
+
+    // Total de pixels de borda (popcount de todas as palavras).
+    long count() const {
+        long total = 0;
+        for (uint64_t word : bits) total += __builtin_popcountll(word);
+        return total;
+    }
+
+    bool operator==(const EdgeMask& other) const {
+        return width == other.width && height == other.height && bits == other.bits;
+    }
+    bool operator!=(const EdgeMask& other) const { return !(*this == other); }
+};
@@ -1,73 +1,921 @@
 #include "EdgeProcessor.h"
 #include <vector>
-#include <cmath>
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
 #include <iostream>
+#include <mutex>
 
-inline uint8_t getPixel(const std::vector<uint8_t>& data, int w, int x, int y) {
-    if (x < 0) x = 0;
-    if (x >= w) x = w - 1;
-    if (y < 0) y = 0;
-    if (y >= w) y = w - 1;
-    return data[y * w + x];
-}
-
-AnalysisResult EdgeProcessor::analyze(const ImageFrame& frame) {
-    int w = frame.width;
-    int h = frame.height;
-    
-    std::vector<uint8_t> grayImage = frame.data; 
-
-    std::vector<uint8_t> blurredImage(w * h);
-    for (int y = 1; y < h - 1; y++) {
-        for (int x = 1; x < w - 1; x++) {
-            int sum = 0;
-            sum += getPixel(grayImage, w, x-1, y-1) * 1;
-            sum += getPixel(grayImage, w, x  , y-1) * 2;
-            sum += getPixel(grayImage, w, x+1, y-1) * 1;
-            sum += getPixel(grayImage, w, x-1, y  ) * 2;
-            sum += getPixel(grayImage, w, x  , y  ) * 4;
-            sum += getPixel(grayImage, w, x+1, y  ) * 2;
-            sum += getPixel(grayImage, w, x-1, y+1) * 1;
-            sum += getPixel(grayImage, w, x  , y+1) * 2;
-            sum += getPixel(grayImage, w, x+1, y+1) * 1;
-            blurredImage[y * w + x] = sum / 16;
-        }
-    }
-
-    int edgePixelCount = 0;
-    int threshold = 100;
-    
-    std::string visualMap;
-    visualMap.reserve((w + 1) * h);
-
-    for (int y = 0; y < h; y++) {
+namespace {
+
+inline uint64_t rotl64(uint64_t v, int r) {
+    return (v << r) | (v >> (64 - r));
+}
+
+// Hash de 64 bits estilo xxhash sobre todos os bytes da regiao (nao amostrado: um pixel
+// diferente precisa mudar o hash, senao o modo incremental reaproveitaria um tile errado).
+uint64_t hashRegion(const ImageView& image, int x0, int x1, int y0, int y1) {
+    const uint64_t P1 = 0x9E3779B185EBCA87ull;
+    const uint64_t P2 = 0xC2B2AE3D27D4EB4Full;
+    const int n = x1 - x0;
+    uint64_t hash = P1 ^ ((uint64_t)n << 32) ^ (uint64_t)(y1 - y0);
+
+    for (int y = y0; y < y1; y++) {
+        const uint8_t* p = image.row(y) + x0;
+        int i = 0;
+        for (; i + 8 <= n; i += 8) {
+            uint64_t v;
+            std::memcpy(&v, p + i, 8);
+            hash = rotl64(hash ^ (v * P2), 31) * P1;
+        }
+        uint64_t tail = 0;
+        for (; i < n; i++) tail = (tail << 8) | p[i];
+        hash = rotl64(hash ^ (tail * P2), 27) * P1 + 0x165667B19E3779F9ull;
+    }
+
+    hash ^= hash >> 33;
+    hash *= P2;
+    hash ^= hash >> 29;
+    return hash;
+}
+
+// Contraste local do modo piramidal para as linhas [y0, y0 + 4): contrast[x] = max - min da imagem
+// nas linhas [y0 - 2, y0 + 6) e colunas [x - 2, x + 2], que contem a janela 5x5 (blur + gradiente)
+// de qualquer pixel (x, y) do bloco. So min/max elemento a elemento, que o compilador vetoriza.
+// low/high/contrast: w bytes cada.
+void localContrast(const ImageView& image, int y0, uint8_t* low, uint8_t* high, uint8_t* contrast) {
+    int w = image.width;
+    int h = image.height;
+    int ya = std::max(y0 - 2, 0);
+    int yb = std::min(y0 + 6, h);
+    std::memcpy(low, image.row(ya), w);
+    std::memcpy(high, image.row(ya), w);
+    for (int y = ya + 1; y < yb; y++) {
+        const uint8_t* row = image.row(y);
         for (int x = 0; x < w; x++) {
-            if (y == 0 || y == h - 1 || x == 0 || x == w - 1) {
-                visualMap += '.';
+            low[x] = std::min(low[x], row[x]);
+            high[x] = std::max(high[x], row[x]);
+        }
+    }
+
+    auto window = [&](int x) {
+        int a = std::max(x - 2, 0), b = std::min(x + 3, w);
+        uint8_t lo = low[a], hi = high[a];
+        for (int i = a + 1; i < b; i++) {
+            lo = std::min(lo, low[i]);
+            hi = std::max(hi, high[i]);
+        }
+        return (uint8_t)(hi - lo);
+    };
+    for (int x = 0; x < std::min(2, w); x++) contrast[x] = window(x);
+    for (int x = 2; x < w - 2; x++) {
+        uint8_t lo = std::min(std::min(low[x - 2], low[x - 1]), std::min(std::min(low[x], low[x + 1]), low[x + 2]));
+        uint8_t hi = std::max(std::max(high[x - 2], high[x - 1]), std::max(std::max(high[x], high[x + 1]), high[x + 2]));
+        contrast[x] = hi - lo;
+    }
+    for (int x = std::max(w - 2, 2); x < w; x++) contrast[x] = window(x);
+}
+
+// Maior contraste local que nao pode gerar borda: com |gx|, |gy| <= ganho * contraste (ganho =
+// soma dos pesos positivos do operador), a metrica fica abaixo do limite de magnitudeLimit.
+int exactPyramidGuard(GradientOperator op, MagnitudeMode mode, int threshold) {
+    if (threshold < 0) return -1;
+    int gain = op == GradientOperator::Scharr ? 16 : op == GradientOperator::Prewitt ? 3 : 4;
+    if (mode == MagnitudeMode::LInf) return threshold / gain;
+    if (mode == MagnitudeMode::L1) return threshold / (2 * gain);
+    long limit = (long)(threshold + 1) * (threshold + 1);
+    int guard = (threshold + 1) / gain;
+    while (guard > 0 && 2L * gain * gain * guard * guard >= limit) guard--;
+    return guard;
+}
+
+// Limite da metrica equivalente a "nivel > k" (ver levelRow).
+int levelLimit(MagnitudeMode mode, int level) {
+    return (level + 1) << (mode == MagnitudeMode::L2 ? kLevelShiftL2 : 2);
+}
+
+// Magnitude representativa de cada nivel (centro do intervalo), para as medias do Otsu.
+// No L2 o nivel e quadratico: a raiz inteira sai de uma varredura so, ja que cresce com k.
+struct LevelMagnitudes {
+    int values[256];
+
+    explicit LevelMagnitudes(MagnitudeMode mode) {
+        int root = 0;
+        for (int k = 0; k < 256; k++) {
+            if (mode != MagnitudeMode::L2) {
+                values[k] = 4 * k + 2;
                 continue;
             }
+            int center = (2 * k + 1) << (kLevelShiftL2 - 1);
+            while ((root + 1) * (root + 1) <= center) root++;
+            values[k] = root;
+        }
+    }
+};
 
-            int gx = -1 * getPixel(blurredImage, w, x-1, y-1) + 1 * getPixel(blurredImage, w, x+1, y-1)
-                     -2 * getPixel(blurredImage, w, x-1, y  ) + 2 * getPixel(blurredImage, w, x+1, y  )
-                     -1 * getPixel(blurredImage, w, x-1, y+1) + 1 * getPixel(blurredImage, w, x+1, y+1);
+// Tabelas montadas uma vez: L1 e LInf tem os mesmos niveis.
+const int* levelMagnitudes(MagnitudeMode mode) {
+    static const LevelMagnitudes quadratic(MagnitudeMode::L2);
+    static const LevelMagnitudes linear(MagnitudeMode::L1);
+    return mode == MagnitudeMode::L2 ? quadratic.values : linear.values;
+}
 
-            int gy = -1 * getPixel(blurredImage, w, x-1, y-1) - 2 * getPixel(blurredImage, w, x  , y-1) - 1 * getPixel(blurredImage, w, x+1, y-1)
-                     +1 * getPixel(blurredImage, w, x-1, y+1) + 2 * getPixel(blurredImage, w, x  , y+1) + 1 * getPixel(blurredImage, w, x+1, y+1);
+// Nivel k que maximiza a variancia entre classes (niveis <= k contra > k), com as medias
+// calculadas nas magnitudes de cada nivel. Tudo em inteiro: o criterio n^2 / (w0 * w1)
+// e comparado como (n / w0) * (n / w1). Nivel vazio repete o corte anterior e nao e avaliado.
+int otsuLevel(const uint32_t* histogram, const int* values) {
+    uint64_t total = 0;
+    uint64_t sum = 0;
+    for (int i = 0; i < 256; i++) {
+        total += histogram[i];
+        sum += (uint64_t)values[i] * histogram[i];
+    }
 
-            int magnitude = std::sqrt(gx*gx + gy*gy);
-            
-            if (magnitude > threshold) {
-                edgePixelCount++;
-                visualMap += '#';
-            } else {
-                visualMap += '.';
+    int best = 255;
+    uint64_t bestScore = 0;
+    uint64_t w0 = 0;
+    uint64_t sum0 = 0;
+    for (int k = 0; k < 255; k++) {
+        if (histogram[k] == 0) continue;
+        w0 += histogram[k];
+        sum0 += (uint64_t)values[k] * histogram[k];
+        uint64_t w1 = total - w0;
+        if (w1 == 0) break;
+
+        // n = w0 * w1 * (media1 - media0) = sum * w0 - sum0 * total (sempre >= 0).
+        uint64_t n = sum * w0 - sum0 * total;
+        uint64_t score = (n / w0) * (n / w1);
+        if (score > bestScore) {
+            bestScore = score;
+            best = k;
+        }
+    }
+    return best;
+}
+
+// Menor nivel k com pelo menos percentile% dos pixels em niveis <= k.
+int percentileLevel(const uint32_t* histogram, int percentile) {
+    uint64_t total = 0;
+    for (int i = 0; i < 256; i++) total += histogram[i];
+
+    uint64_t target = total * (uint64_t)std::min(std::max(percentile, 0), 100);
+    uint64_t cumulative = 0;
+    for (int k = 0; k < 255; k++) {
+        cumulative += histogram[k];
+        if (cumulative * 100 >= target) return k;
+    }
+    return 255;
+}
+
+// Densidade em Q16 sempre por inteiros; a versao float so existe fora do build sem float.
+void setDensity(AnalysisResult& result, long edgePixels, long pixels) {
+    result.edge_density_q16 = q16::fromRatio((uint64_t)edgePixels, (uint64_t)pixels);
+#ifndef EDGE_FIXED_POINT
+    result.edge_density = (float)edgePixels / pixels;
+#endif
+}
+
+// Variancia do Laplaciano 4*c - (n + s + l + o) numa grade de passo 4 sobre o interior.
+// Soma e soma dos quadrados em inteiro: |L| <= 1020, entao 64 bits sobram para qualquer frame.
+uint32_t laplacianVariance(const ImageView& image) {
+    const int step = 4;
+    int64_t sum = 0;
+    uint64_t squares = 0;
+    int64_t count = 0;
+    for (int y = 1; y < image.height - 1; y += step) {
+        const uint8_t* up = image.row(y - 1);
+        const uint8_t* row = image.row(y);
+        const uint8_t* down = image.row(y + 1);
+        for (int x = 1; x < image.width - 1; x += step) {
+            int laplacian = 4 * row[x] - row[x - 1] - row[x + 1] - up[x] - down[x];
+            sum += laplacian;
+            squares += (uint64_t)(laplacian * laplacian);
+            count++;
+        }
+    }
+    if (count == 0) return 0;
+    return (uint32_t)((squares - (uint64_t)(sum * sum / count)) / count);
+}
+
+// floor(sqrt(v)) em 64 bits, bit a bit.
+uint64_t isqrt64(uint64_t v) {
+    uint64_t root = 0;
+    for (uint64_t bit = 1ull << 62; bit; bit >>= 2) {
+        if (v >= root + bit) {
+            v -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+    }
+    return root;
+}
+
+// Phi(z) da normal padrao em Q16, com z em passos de 0.25 de 0 a 4 e interpolacao linear.
+uint32_t normalCdfQ16(uint64_t zQ8) {
+    static const uint32_t table[17] = { 32768, 39237, 45316, 50684, 55138, 58612, 61158, 62911, 64045,
+                                        64735, 65129, 65341, 65448, 65498, 65521, 65530, 65534 };
+    if (zQ8 >= 16 * 64) return table[16];
+    uint32_t i = (uint32_t)(zQ8 / 64);
+    uint32_t f = (uint32_t)(zQ8 % 64);
+    return table[i] + (table[i + 1] - table[i]) * f / 64;
+}
+
+// Soma os grupos de 16 bins (faixas ou tiles) no resultado e escolhe a direcao dominante.
+void setOrientation(AnalysisResult& result, const uint64_t* bins, size_t groups) {
+    uint64_t* histogram = result.orientation_histogram;
+    std::fill(histogram, histogram + kOrientationBins, 0);
+    for (size_t g = 0; g < groups; g++) {
+        for (int i = 0; i < kOrientationBins; i++) histogram[i] += bins[g * kOrientationBins + i];
+    }
+
+    int best = 0;
+    for (int i = 1; i < kOrientationBins; i++) {
+        if (histogram[i] > histogram[best]) best = i;
+    }
+    // Centro do bin em graus inteiros: best * 11.25.
+    result.dominant_direction_deg = histogram[best] ? best * 1125 / 100 : -1;
+}
+
+}
+
+// Decisao de borda de um pixel interior isolado: as 5x5 vizinhas (com o mesmo clamp do frame)
+// passam por blur e gradiente escalares numa janela de 5 colunas; o bit 2 e o pixel (x, y).
+bool EdgeProcessor::sampleEdge(const ImageView& image, int x, int y, int threshold) const {
+    const EdgeKernels& scalar = scalarEdgeKernels();
+    uint8_t raw[5][8];
+    uint8_t blurred[3][8];
+    for (int r = 0; r < 5; r++) {
+        const uint8_t* row = image.row(std::min(std::max(y - 2 + r, 0), image.height - 1));
+        for (int c = 0; c < 5; c++) raw[r][c] = row[std::min(std::max(x - 2 + c, 0), image.width - 1)];
+    }
+    for (int r = 0; r < 3; r++) scalar.blurRow(raw[r], raw[r + 1], raw[r + 2], 5, blurred[r]);
+
+    uint64_t word = 0;
+    scalar.gradientFor(gradientOperator, magnitudeMode)(blurred[0], blurred[1], blurred[2], 5, threshold, &word);
+    return (word >> 2) & 1;
+}
+
+// Teste sequencial da proporcao contra o nivel de alarme A: com n amostras e k bordas, decide
+// quando (k - nA)^2 > 9 n A (1 - A), ou seja |z| > 3 sob a hipotese densidade = A. O teste so
+// e refeito ao fim de cada rodada da grade, e o z alto compensa as olhadas repetidas.
+// Tudo em inteiro: k e A em Q16, entao os dois lados ficam multiplicados por 2^32.
+bool EdgeProcessor::estimateAlarm(const ImageView& image, int threshold, AnalysisResult& result) {
+    const int kGrid = 16;
+    const int kMinSamples = 512;
+    const int kMaxSamples = 8192;
+
+    int w = image.width;
+    int h = image.height;
+    int cellsX = std::min(kGrid, w - 2);
+    int cellsY = std::min(kGrid, h - 2);
+    int cells = cellsX * cellsY;
+    long interior = (long)(w - 2) * (h - 2);
+    int budget = (int)std::min<long>(kMaxSamples, interior / 8);
+    if (budget < kMinSamples) return false;
+
+    uint32_t level = std::min<uint32_t>(std::max<uint32_t>(alarmDensity, 1), q16::One - 1);
+    uint64_t unitVariance = (uint64_t)level * (q16::One - level);
+
+    auto nextRandom = [&](int range) {
+        sampleState ^= sampleState << 13;
+        sampleState ^= sampleState >> 17;
+        sampleState ^= sampleState << 5;
+        return (int)(((uint64_t)sampleState * (uint32_t)range) >> 32);
+    };
+
+    long hits = 0;
+    int samples = 0;
+    while (samples + cells <= budget) {
+        // Uma rodada: um pixel uniforme em cada celula da grade sobre o interior [1, w-1) x [1, h-1).
+        for (int cy = 0; cy < cellsY; cy++) {
+            int y0 = 1 + (int)((long)(h - 2) * cy / cellsY);
+            int y1 = 1 + (int)((long)(h - 2) * (cy + 1) / cellsY);
+            for (int cx = 0; cx < cellsX; cx++) {
+                int x0 = 1 + (int)((long)(w - 2) * cx / cellsX);
+                int x1 = 1 + (int)((long)(w - 2) * (cx + 1) / cellsX);
+                hits += sampleEdge(image, x0 + nextRandom(x1 - x0), y0 + nextRandom(y1 - y0), threshold);
+            }
+        }
+        samples += cells;
+        if (samples < kMinSamples) continue;
+
+        int64_t deviation = (int64_t)hits * q16::One - (int64_t)samples * level;
+        uint64_t variance = (uint64_t)samples * unitVariance;
+        uint64_t squared = (uint64_t)(deviation * deviation);
+        if (squared <= 9 * variance) continue;
+
+        uint64_t magnitude = (uint64_t)(deviation < 0 ? -deviation : deviation);
+        result.edge_mask.reset(w, h);
+        setDensity(result, hits, samples);
+        result.alarm = deviation > 0;
+        result.sampled_pixels = samples;
+        result.confidence_q16 = normalCdfQ16(magnitude * 256 / std::max<uint64_t>(isqrt64(variance), 1));
+#ifndef EDGE_FIXED_POINT
+        result.confidence = result.confidence_q16 / 65536.0f;
+#endif
+        return true;
+    }
+    return false;
+}
+
+// Calcula as linhas de saida [yBegin, yEnd) do Sobel (1 <= yBegin, yEnd <= h-1).
+// A faixa le uma linha de halo borrada acima e abaixo, ou seja, duas linhas da imagem,
+// e so escreve nas suas proprias linhas da mascara, entao faixas diferentes podem rodar em paralelo.
+void EdgeProcessor::analyzeBand(const ImageView& image, int yBegin, int yEnd, int threshold,
+                               uint8_t* ring, EdgeMask& mask, uint16_t* magnitude,
+                               uint8_t* levels, uint64_t* orientation) const {
+    int w = image.width;
+    int h = image.height;
+    GradientRowFn gradientRow = kernels->gradientFor(gradientOperator, magnitudeMode);
+    LevelRowFn levelRow = kernels->levelFor(gradientOperator, magnitudeMode);
+
+    // Linha r do borrado, com as linhas vizinhas limitadas a [0, h-1] (borda replicada em y).
+    auto blurInto = [&](int r, uint8_t* out) {
+        const uint8_t* above = image.row(r > 0 ? r - 1 : 0);
+        const uint8_t* below = image.row(r < h - 1 ? r + 1 : h - 1);
+        kernels->blurRow(above, image.row(r), below, w, out);
+    };
+
+    // Blur e Sobel fundidos: so as tres linhas borradas que o Sobel enxerga ficam em memoria.
+    uint8_t* rows[3] = { ring, ring + ringStride, ring + 2 * ringStride };
+
+    blurInto(yBegin - 1, rows[0]);
+    blurInto(yBegin, rows[1]);
+
+    for (int y = yBegin; y < yEnd; y++) {
+        blurInto(y + 1, rows[2]);
+
+        if (levels) {
+            levelRow(rows[0], rows[1], rows[2], w, levels + (size_t)y * w);
+        } else {
+            gradientRow(rows[0], rows[1], rows[2], w, threshold, mask.row(y));
+            if (orientation) {
+                kernels->orientationFor(gradientOperator)(rows[0], rows[1], rows[2], mask.row(y), w, orientation);
             }
         }
-        visualMap += '\n';
+        if (magnitude) {
+            kernels->magnitudeFor(gradientOperator)(rows[0], rows[1], rows[2], w, magnitude + y * w);
+        }
+
+        std::rotate(rows, rows + 1, rows + 3);
+    }
+}
+
+// Saida do Sobel apenas nas colunas [x0, x1) e linhas [y0, y1) (x0 e x1 multiplos de 64, ou x1 == w).
+// O blur e calculado so na janela de colunas que o Sobel enxerga; quando a janela nao encosta
+// na borda da imagem, a coluna extra de cada lado absorve o clamp do kernel e e descartada.
+// O Sobel escreve numa linha temporaria relativa a janela, copiada palavra a palavra para a mascara.
+void EdgeProcessor::analyzeWindow(const ImageView& image, int x0, int x1, int y0, int y1, int threshold,
+                                  uint8_t* scratch, EdgeMask& mask, uint64_t* orientation) const {
+    int w = image.width;
+    int h = image.height;
+    int cx0 = std::max(x0, 1);
+    int cx1 = std::min(x1, w - 1);
+    int cy0 = std::max(y0, 1);
+    int cy1 = std::min(y1, h - 1);
+    if (cx0 >= cx1 || cy0 >= cy1) return;
+
+    GradientRowFn gradientRow = kernels->gradientFor(gradientOperator, magnitudeMode);
+    int s = cx0 - 1;                    // coluna da imagem que corresponde ao indice 0 da janela do Sobel
+    int n = cx1 - cx0 + 2;
+    int a = std::max(s - 1, 0);         // janela do blur: [a, b)
+    int b = std::min(cx1 + 2, w);
+    int off = x0 - s;                   // 0 no tile da esquerda, 1 nos demais
+    int words = (x1 - x0 + 63) / 64;
+
+    auto blurInto = [&](int r, uint8_t* out) {
+        const uint8_t* above = image.row(r > 0 ? r - 1 : 0);
+        const uint8_t* below = image.row(r < h - 1 ? r + 1 : h - 1);
+        kernels->blurRow(above + a, image.row(r) + a, below + a, b - a, out + a);
+    };
+
+    uint8_t* rows[3] = { scratch, scratch + ringStride, scratch + 2 * ringStride };
+    uint64_t* temp = reinterpret_cast<uint64_t*>(scratch + 3 * ringStride);
+
+    blurInto(cy0 - 1, rows[0]);
+    blurInto(cy0, rows[1]);
+
+    for (int y = cy0; y < cy1; y++) {
+        blurInto(y + 1, rows[2]);
+
+        gradientRow(rows[0] + s, rows[1] + s, rows[2] + s, n, threshold, temp);
+        temp[(n + 63) / 64] = 0;
+        if (orientation) {
+            // Os bits 1..n-2 da linha temporaria sao exatamente as colunas do tile.
+            kernels->orientationFor(gradientOperator)(rows[0] + s, rows[1] + s, rows[2] + s, temp, n, orientation);
+        }
+
+        uint64_t* dst = mask.row(y) + x0 / 64;
+        for (int k = 0; k < words; k++) {
+            dst[k] = off ? (temp[k] >> 1) | (temp[k + 1] << 63) : temp[k];
+        }
+
+        std::rotate(rows, rows + 1, rows + 3);
     }
+}
+
+void EdgeProcessor::reserveWorkspace(int w, int bands) {
+    // Por faixa: 3 linhas do anel + 1 linha temporaria de mascara (usada pelo modo incremental).
+    ringStride = (w + 63) & ~63;
+    size_t needed = (size_t)ringStride * 4 * bands;
+    if (workspace.size() < needed) workspace.resize(needed);
+}
 
-    float density = (float)edgePixelCount / (w * h);
-    
-    return { density, 0.95f, 0, visualMap };
-}
\ No newline at end of file
+void EdgeProcessor::setIncremental(bool enabled, int size) {
+    incremental = enabled;
+    tileSize = std::max(64, (size + 63) / 64 * 64);
+    tileValid.clear();
+}
+
+void EdgeProcessor::setPyramid(bool enabled, int guardThreshold, int size) {
+    pyramid = enabled;
+    pyramidGuard = guardThreshold;
+    pyramidTileSize = std::max(64, (size + 63) / 64 * 64);
+}
+
+void EdgeProcessor::analyzePyramid(const ImageView& image, int threshold, AnalysisResult& result) {
+    int w = image.width;
+    int h = image.height;
+    int tilesX = (w + pyramidTileSize - 1) / pyramidTileSize;
+    int tilesY = (h + pyramidTileSize - 1) / pyramidTileSize;
+    int guard = pyramidGuard < 0 ? exactPyramidGuard(gradientOperator, magnitudeMode, threshold) : pyramidGuard;
+
+    reserveWorkspace(w, std::max(1, std::min(threadCount(), tilesY)));
+    EdgeMask& mask = result.edge_mask;
+    mask.reset(w, h);
+    result.refined_tiles.assign((size_t)tilesX * tilesY, 0);
+    pyramidCounts.assign((size_t)tilesX * tilesY, 0);
+    uint64_t* orientation = nullptr;
+    if (orientationOutput) {
+        orientationBins.assign((size_t)tilesX * tilesY * kOrientationBins, 0);
+        orientation = orientationBins.data();
+    }
+
+    int bands = std::min(threadCount(), tilesY);
+    auto processBand = [&](int band) {
+        uint8_t* scratch = workspace.data() + (size_t)band * 4 * ringStride;
+        for (int ty = band; ty < tilesY; ty += bands) {
+            int y0 = ty * pyramidTileSize;
+            int y1 = std::min(y0 + pyramidTileSize, h);
+            uint8_t* refined = result.refined_tiles.data() + (size_t)ty * tilesX;
+
+            // Nivel grosso: contraste local em blocos de 4 linhas (o rascunho da faixa ainda esta livre),
+            // ate todos os tiles da linha estarem decididos.
+            int pending = tilesX;
+            for (int yb = y0; yb < y1 && pending > 0; yb += 4) {
+                uint8_t* contrast = scratch + 2 * ringStride;
+                localContrast(image, yb, scratch, scratch + ringStride, contrast);
+                for (int tx = 0; tx < tilesX; tx++) {
+                    if (refined[tx]) continue;
+                    int x1 = std::min((tx + 1) * pyramidTileSize, w);
+                    uint8_t peak = 0;
+                    for (int x = tx * pyramidTileSize; x < x1; x++) peak = std::max(peak, contrast[x]);
+                    refined[tx] = peak > guard;
+                    pending -= refined[tx];
+                }
+            }
+
+            // Tiles refinados vizinhos viram uma janela so (menos halo e menos cauda escalar).
+            for (int tx = 0; tx < tilesX;) {
+                if (!refined[tx]) {
+                    tx++;   // tile pulado: mascara vazia, contagem zero
+                    continue;
+                }
+                int end = tx + 1;
+                while (end < tilesX && refined[end]) end++;
+                size_t i = (size_t)ty * tilesX + tx;
+                int x0 = tx * pyramidTileSize;
+                int x1 = std::min(end * pyramidTileSize, w);
+
+                analyzeWindow(image, x0, x1, y0, y1, threshold, scratch, mask,
+                              orientation ? orientation + i * kOrientationBins : nullptr);
+                int count = 0;
+                for (int y = y0; y < y1; y++) {
+                    const uint64_t* row = mask.row(y) + x0 / 64;
+                    for (int k = 0; k < (x1 - x0 + 63) / 64; k++) count += __builtin_popcountll(row[k]);
+                }
+                pyramidCounts[i] = count;
+                tx = end;
+            }
+        }
+    };
+
+    if (bands <= 1) {
+        processBand(0);
+    } else {
+        pool->run(bands, processBand);
+    }
+
+    long edgePixelCount = 0;
+    int refined = 0;
+    for (size_t i = 0; i < pyramidCounts.size(); i++) {
+        edgePixelCount += pyramidCounts[i];
+        refined += result.refined_tiles[i];
+    }
+
+    setDensity(result, edgePixelCount, (long)w * h);
+    if (orientation) setOrientation(result, orientation, (size_t)tilesX * tilesY);
+    result.tiles_x = tilesX;
+    result.tiles_total = tilesX * tilesY;
+    result.tiles_refined = refined;
+}
+
+void EdgeProcessor::analyzeIncremental(const ImageView& image, int threshold, AnalysisResult& result) {
+    int w = image.width;
+    int h = image.height;
+    int tilesX = (w + tileSize - 1) / tileSize;
+    int tilesY = (h + tileSize - 1) / tileSize;
+    size_t tiles = (size_t)tilesX * tilesY;
+
+    // Qualquer mudanca de resolucao ou de parametro invalida o cache inteiro.
+    if (tileMask.width != w || tileMask.height != h || tileValid.size() != tiles ||
+        cachedThreshold != threshold || cachedMode != magnitudeMode || cachedOperator != gradientOperator ||
+        cachedOrientation != orientationOutput) {
+        tileMask.reset(w, h);
+        tileHashes.assign(tiles, 0);
+        tileCounts.assign(tiles, 0);
+        tileValid.assign(tiles, 0);
+        tileReused.assign(tiles, 0);
+        tileOrientation.assign(orientationOutput ? tiles * kOrientationBins : 0, 0);
+        cachedThreshold = threshold;
+        cachedMode = magnitudeMode;
+        cachedOperator = gradientOperator;
+        cachedOrientation = orientationOutput;
+    }
+
+    int bands = std::min(threadCount(), tilesY);
+    reserveWorkspace(w, bands);
+
+    // Cada tarefa cuida de linhas de tiles inteiras (ty % bands == band) com o seu rascunho.
+    // O hash cobre o tile mais 2 pixels de halo: e tudo o que o blur + Sobel do tile enxerga.
+    auto processBand = [&](int band) {
+        uint8_t* scratch = workspace.data() + (size_t)band * 4 * ringStride;
+        for (int ty = band; ty < tilesY; ty += bands) {
+            int y0 = ty * tileSize;
+            int y1 = std::min(y0 + tileSize, h);
+            for (int tx = 0; tx < tilesX; tx++) {
+                size_t i = (size_t)ty * tilesX + tx;
+                int x0 = tx * tileSize;
+                int x1 = std::min(x0 + tileSize, w);
+
+                uint64_t hash = hashRegion(image, std::max(x0 - 2, 0), std::min(x1 + 2, w),
+                                           std::max(y0 - 2, 0), std::min(y1 + 2, h));
+                if (tileValid[i] && tileHashes[i] == hash) {
+                    tileReused[i] = 1;
+                    continue;
+                }
+
+                uint64_t* orientation = nullptr;
+                if (orientationOutput) {
+                    orientation = tileOrientation.data() + i * kOrientationBins;
+                    std::fill(orientation, orientation + kOrientationBins, 0);
+                }
+                analyzeWindow(image, x0, x1, y0, y1, threshold, scratch, tileMask, orientation);
+
+                int count = 0;
+                for (int y = y0; y < y1; y++) {
+                    const uint64_t* row = tileMask.row(y) + x0 / 64;
+                    for (int k = 0; k < (x1 - x0 + 63) / 64; k++) count += __builtin_popcountll(row[k]);
+                }
+                tileCounts[i] = count;
+                tileHashes[i] = hash;
+                tileValid[i] = 1;
+                tileReused[i] = 0;
+            }
+        }
+    };
+
+    if (bands <= 1) {
+        processBand(0);
+    } else {
+        pool->run(bands, processBand);
+    }
+
+    long edgePixelCount = 0;
+    int reused = 0;
+    for (size_t i = 0; i < tiles; i++) {
+        edgePixelCount += tileCounts[i];
+        reused += tileReused[i];
+    }
+
+    result.edge_mask = tileMask;
+    setDensity(result, edgePixelCount, (long)w * h);
+    if (orientationOutput) setOrientation(result, tileOrientation.data(), tiles);
+    result.tiles_x = tilesX;
+    result.tiles_total = (int)tiles;
+    result.tiles_reused = reused;
+}
+
+long EdgeProcessor::analyzeAdaptive(const ImageView& image, uint16_t* magnitude, AnalysisResult& result) {
+    int w = image.width;
+    int h = image.height;
+    int interiorRows = h - 2;
+    int bands = std::min(threadCount(), interiorRows);
+
+    reserveWorkspace(w, bands);
+    levelBuffer.resize((size_t)w * h);
+    histograms.assign((size_t)bands * 1024, 0);
+    EdgeMask& mask = result.edge_mask;
+
+    // Passo 1: niveis e histograma por faixa. Passo 2: mascara a partir dos niveis.
+    auto bandRows = [&](int band, int& yBegin, int& yEnd) {
+        yBegin = 1 + (int)((long long)interiorRows * band / bands);
+        yEnd = 1 + (int)((long long)interiorRows * (band + 1) / bands);
+    };
+    auto levelPass = [&](int band) {
+        int yBegin, yEnd;
+        bandRows(band, yBegin, yEnd);
+        uint8_t* ring = workspace.data() + (size_t)band * 4 * ringStride;
+        analyzeBand(image, yBegin, yEnd, 0, ring, mask, magnitude, levelBuffer.data());
+        // As linhas da faixa sao contiguas: um so passo conta todas, e o zero das colunas 0 e
+        // w-1 de cada linha sai do nivel 0 depois.
+        uint32_t* histogram = histograms.data() + band * 1024;
+        kernels->levelHistogram(levelBuffer.data() + (size_t)yBegin * w, (yEnd - yBegin) * w, histogram);
+        histogram[0] -= 2 * (uint32_t)(yEnd - yBegin);
+    };
+    if (bands <= 1) {
+        levelPass(0);
+    } else {
+        pool->run(bands, levelPass);
+    }
+
+    uint32_t* histogram = histograms.data();
+    for (size_t k = 1; k < (size_t)bands * 4; k++) {
+        for (int i = 0; i < 256; i++) histogram[i] += histograms[k * 256 + i];
+    }
+    int level = thresholdMode == ThresholdMode::Otsu ? otsuLevel(histogram, levelMagnitudes(magnitudeMode))
+                                                     : percentileLevel(histogram, thresholdPercentile);
+
+    auto maskPass = [&](int band) {
+        int yBegin, yEnd;
+        bandRows(band, yBegin, yEnd);
+        if (w % 64 == 0) {
+            // Linhas da mascara sem palavra parcial: contiguas como as dos niveis, uma chamada cobre a faixa.
+            kernels->thresholdRow(levelBuffer.data() + (size_t)yBegin * w, (yEnd - yBegin) * w, level, mask.row(yBegin));
+            return;
+        }
+        for (int y = yBegin; y < yEnd; y++) {
+            kernels->thresholdRow(levelBuffer.data() + (size_t)y * w, w, level, mask.row(y));
+        }
+    };
+    if (bands <= 1) {
+        maskPass(0);
+    } else {
+        pool->run(bands, maskPass);
+    }
+
+    // Limiar equivalente em magnitude: borda quando metrica >= limit. No L1/LInf e exato (limit - 1);
+    // no L2 o limite quadratico cai entre threshold e threshold + 1.
+    int limit = levelLimit(magnitudeMode, level);
+    int threshold = limit - 1;
+    if (magnitudeMode == MagnitudeMode::L2) {
+        threshold = 0;
+        while ((threshold + 1) * (threshold + 1) < limit) threshold++;
+    }
+    result.threshold = threshold;
+
+    // Borda = nivel acima do corte; as colunas 0 e w-1 (nivel 0) ja sairam do histograma.
+    long edgePixels = 0;
+    for (int k = level + 1; k < 256; k++) edgePixels += histogram[k];
+    return edgePixels;
+}
+
+AnalysisResult EdgeProcessor::analyze(const ImageView& image) {
+    AnalysisResult result;
+    analyze(image, result);
+    return result;
+}
+
+void EdgeProcessor::analyze(const ImageView& image, AnalysisResult& result) {
+    int w = image.width;
+    int h = image.height;
+
+    int threshold = fixedThreshold;
+    bool adaptive = thresholdMode != ThresholdMode::Fixed;
+
+    result.confidence_q16 = q16::One;   // passo completo: densidade exata
+#ifndef EDGE_FIXED_POINT
+    result.confidence = 1.0f;
+#endif
+    result.alarm = false;
+    result.sampled_pixels = 0;
+    result.sharpness = 0;
+    result.reject_reason = RejectReason::None;
+    result.process_time_ms = 0;
+    result.threshold = threshold;
+    result.tiles_x = 0;
+    result.tiles_total = 0;
+    result.tiles_reused = 0;
+    result.tiles_refined = 0;
+    result.refined_tiles.clear();
+    std::fill(result.orientation_histogram, result.orientation_histogram + kOrientationBins, 0);
+    result.dominant_direction_deg = -1;
+
+    stats.frames++;
+    if (sharpnessGate) {
+        result.sharpness = laplacianVariance(image);
+        if (result.sharpness < sharpnessMin) {
+            stats.rejected++;
+            result.reject_reason = RejectReason::Blurry;
+            result.edge_mask.reset(w, h);
+            setDensity(result, 0, 1);
+            result.confidence_q16 = 0;
+#ifndef EDGE_FIXED_POINT
+            result.confidence = 0;
+#endif
+            result.gradient_magnitude.clear();
+            result.segments.clear();
+            result.segments_dropped = 0;
+            return;
+        }
+    }
+
+    if (alarmEstimate && !adaptive && !gradientOutput && w >= 3 && h >= 3 && estimateAlarm(image, threshold, result)) {
+        // Alarme decidido pela amostra: sem passo completo.
+        result.gradient_magnitude.clear();
+        result.segments.clear();
+        result.segments_dropped = 0;
+        return;
+    }
+
+    if (pyramid && !adaptive && !gradientOutput && w >= 3 && h >= 3) {
+        result.gradient_magnitude.clear();
+        analyzePyramid(image, threshold, result);
+    } else if (incremental && !adaptive && !gradientOutput && w >= 3 && h >= 3) {
+        // Sem saida de magnitude: o cache de tiles guarda so mascara e contagem.
+        result.gradient_magnitude.clear();
+        analyzeIncremental(image, threshold, result);
+    } else {
+        analyzeFull(image, threshold, result);
+    }
+
+    if (alarmEstimate) result.alarm = result.edge_density_q16 >= alarmDensity;
+
+    if (segmentation) {
+        result.segments_dropped = segmenter.segment(result.edge_mask, result.segments);
+    } else {
+        result.segments.clear();
+        result.segments_dropped = 0;
+    }
+}
+
+void EdgeProcessor::analyzeFull(const ImageView& image, int threshold, AnalysisResult& result) {
+    int w = image.width;
+    int h = image.height;
+
+    // Mascara zerada: as linhas 0 e h-1 (e as colunas de borda) nunca sao marcadas.
+    // reset/assign reaproveitam a capacidade que o resultado ja tem.
+    EdgeMask& mask = result.edge_mask;
+    mask.reset(w, h);
+
+    if (gradientOutput) {
+        result.gradient_magnitude.assign((size_t)w * h, 0);
+    } else {
+        result.gradient_magnitude.clear();
+    }
+    uint16_t* magnitude = gradientOutput ? result.gradient_magnitude.data() : nullptr;
+
+    int interiorRows = h - 2;
+    int bands = std::min(threadCount(), interiorRows);
+    bool fixed = thresholdMode == ThresholdMode::Fixed;
+
+    uint64_t* orientation = nullptr;
+    if (orientationOutput && fixed && bands > 0) {
+        orientationBins.assign((size_t)bands * kOrientationBins, 0);
+        orientation = orientationBins.data();
+    }
+
+    long edgePixels = -1;
+    if (w < 3 || h < 3) {
+        // Frame so de borda: nada para analisar.
+    } else if (!fixed) {
+        edgePixels = analyzeAdaptive(image, magnitude, result);
+    } else if (bands <= 1) {
+        reserveWorkspace(w, 1);
+        analyzeBand(image, 1, h - 1, threshold, workspace.data(), mask, magnitude, nullptr, orientation);
+    } else {
+        reserveWorkspace(w, bands);
+        // Faixas escrevem linhas disjuntas da mascara; a contagem sai depois, por popcount.
+        pool->run(bands, [&](int band) {
+            int yBegin = 1 + (int)((long long)interiorRows * band / bands);
+            int yEnd = 1 + (int)((long long)interiorRows * (band + 1) / bands);
+            uint8_t* ring = workspace.data() + (size_t)band * 4 * ringStride;
+            analyzeBand(image, yBegin, yEnd, threshold, ring, mask, magnitude, nullptr,
+                        orientation ? orientation + band * kOrientationBins : nullptr);
+        });
+    }
+
+    setDensity(result, edgePixels >= 0 ? edgePixels : mask.count(), (long)w * h);
+    if (orientation) setOrientation(result, orientation, bands);
+}
+
+// Copia a configuracao para um processador de lote (sempre de uma thread: o paralelismo e por frame).
+void EdgeProcessor::configureLane(EdgeProcessor& lane) const {
+    lane.kernels = kernels;
+    lane.magnitudeMode = magnitudeMode;
+    lane.gradientOperator = gradientOperator;
+    lane.gradientOutput = gradientOutput;
+    lane.orientationOutput = orientationOutput;
+    lane.fixedThreshold = fixedThreshold;
+    lane.thresholdMode = thresholdMode;
+    lane.thresholdPercentile = thresholdPercentile;
+    lane.segmentation = segmentation;
+    lane.segmenter.setMinPixels(segmenter.getMinPixels());
+    lane.sharpnessGate = sharpnessGate;
+    lane.sharpnessMin = sharpnessMin;
+    lane.alarmEstimate = alarmEstimate;
+    lane.alarmDensity = alarmDensity;
+    if (lane.incremental != incremental || lane.tileSize != tileSize) lane.setIncremental(incremental, tileSize);
+    lane.pyramid = pyramid;
+    lane.pyramidGuard = pyramidGuard;
+    lane.pyramidTileSize = pyramidTileSize;
+}
+
+uint32_t EdgeProcessor::calibrateSharpnessGate(const std::vector<ImageView>& reference, uint32_t percent) {
+    std::vector<uint32_t> values;
+    for (const ImageView& frame : reference) values.push_back(laplacianVariance(frame));
+    uint32_t median = 0;
+    if (!values.empty()) {
+        std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+        median = values[values.size() / 2];
+    }
+    setSharpnessGate(true, (uint32_t)((uint64_t)median * percent / 100));
+    return sharpnessMin;
+}
+
+QualityStats EdgeProcessor::qualityStats() const {
+    QualityStats total = stats;
+    for (const auto& lane : batchLanes) {
+        total.frames += lane->stats.frames;
+        total.rejected += lane->stats.rejected;
+    }
+    return total;
+}
+
+void EdgeProcessor::resetQualityStats() {
+    stats = QualityStats();
+    for (auto& lane : batchLanes) lane->stats = QualityStats();
+}
+
+std::vector<AnalysisResult> EdgeProcessor::analyzeBatch(const ImageFrame* frames, size_t count) {
+    std::vector<AnalysisResult> results(count);
+    runBatch(frames, count, results.data(), count, nullptr, nullptr);
+    return results;
+}
+
+void EdgeProcessor::streamBatch(const ImageFrame* frames, size_t count, const void* callback, BatchCallback emit) {
+    size_t slots = (size_t)threadCount() * 2;
+    if (batchSlots.size() < slots) batchSlots.resize(slots);
+    batchDone.assign(slots, 0);
+    runBatch(frames, count, batchSlots.data(), slots, callback, emit);
+}
+
+void EdgeProcessor::runBatch(const ImageFrame* frames, size_t count, AnalysisResult* slots, size_t slotCount,
+                             const void* callback, BatchCallback emit) {
+    int lanes = (int)std::min<size_t>((size_t)threadCount(), count);
+    if (lanes <= 1) {
+        for (size_t i = 0; i < count; i++) {
+            AnalysisResult& result = slots[i % slotCount];
+            analyze(frames[i], result);
+            if (emit) emit(callback, i, result);
+        }
+        return;
+    }
+
+    while ((int)batchLanes.size() < lanes) batchLanes.push_back(std::make_unique<EdgeProcessor>());
+    for (int k = 0; k < lanes; k++) configureLane(*batchLanes[k]);
+
+    // Cada tarefa puxa o proximo frame livre (balanceia frames de custo diferente). Na variante em
+    // fluxo, quem completa o proximo frame da fila entrega ele e os seguintes ja prontos, e um frame
+    // so comeca quando o seu slot do anel ja foi entregue: o menor frame pendente nunca espera,
+    // entao o lote sempre anda.
+    std::atomic<size_t> next{0};
+    std::mutex mutex;
+    std::condition_variable freed;
+    size_t emitted = 0;
+
+    pool->run(lanes, [&](int lane) {
+        EdgeProcessor& processor = *batchLanes[lane];
+        for (size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+            size_t slot = i % slotCount;
+            if (emit) {
+                std::unique_lock<std::mutex> lock(mutex);
+                freed.wait(lock, [&] { return i < emitted + slotCount; });
+            }
+
+            processor.analyze(frames[i], slots[slot]);
+            if (!emit) continue;
+
+            std::lock_guard<std::mutex> lock(mutex);
+            batchDone[slot] = 1;
+            while (emitted < count && batchDone[emitted % slotCount]) {
+                batchDone[emitted % slotCount] = 0;
+                emit(callback, emitted, slots[emitted % slotCount]);
+                emitted++;
+            }
+            freed.notify_all();
+        }
+    });
+}
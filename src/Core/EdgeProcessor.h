@@ -1,16 +1,319 @@
 #pragma once
 #include "../HAL/ICamera.h"
+#include "AlignedAllocator.h"
+#include "CrackSegmenter.h"
+#include "EdgeKernels.h"
+#include "EdgeMask.h"
+#include "FixedPoint.h"
+#include "WorkerPool.h"
+#include <memory>
 #include <vector>
 #include <string>
 
+// Caminho sem ponto flutuante: com EDGE_FIXED_POINT a analise so usa inteiros, os campos float
+// do resultado ficam em 0 e valem os campos _q16. E o padrao no Arduino (EDGE_FLOAT desliga);
+// no host, cmake -DEDGE_FIXED_POINT=ON compila o mesmo codigo para testar a numerica do device.
+#if defined(ARDUINO) && !defined(EDGE_FLOAT) && !defined(EDGE_FIXED_POINT)
+#define EDGE_FIXED_POINT
+#endif
+
+// Escolha do limiar de borda. Fixed usa o valor de setThreshold. Otsu e Percentile escolhem o
+// limiar a cada frame pelo histograma dos niveis de magnitude gravados no passo do gradiente.
+enum class ThresholdMode {
+    Fixed,
+    Otsu,
+    Percentile
+};
+
+// Motivo de descarte de um frame antes da analise completa.
+enum class RejectReason {
+    None,
+    Blurry      // nitidez abaixo do minimo (fora de foco ou tremido)
+};
+
+inline const char* rejectReasonName(RejectReason reason) {
+    return reason == RejectReason::Blurry ? "blurry" : "none";
+}
+
+// Contadores do filtro de qualidade desde o ultimo resetQualityStats().
+struct QualityStats {
+    uint32_t frames = 0;
+    uint32_t rejected = 0;
+};
+
 struct AnalysisResult {
-    float edge_density;
-    float confidence;
-    long process_time_ms;
-    std::string ascii_map;
+    float edge_density = 0;
+    // Confianca no resultado: 1 quando a densidade veio do passo completo (exata); na estimativa
+    // amostrada do modo de alarme, a probabilidade de a decisao de alarme estar certa.
+    float confidence = 0;
+    long process_time_ms = 0;
+    // Mesmos valores em Q16, calculados so com inteiros e identicos em qualquer build.
+    uint32_t edge_density_q16 = 0;
+    uint32_t confidence_q16 = 0;
+    // Modo de alarme (setAlarmEstimate): densidade >= nivel de alarme, e quantos pixels a amostragem
+    // avaliou quando decidiu sozinha (0 = resultado do passo completo; com amostra, mascara vazia).
+    bool alarm = false;
+    int sampled_pixels = 0;
+    // Filtro de nitidez (setSharpnessGate): variancia do Laplaciano amostrado e motivo de descarte.
+    // Frame descartado: sem analise, mascara vazia, densidade e confianca 0.
+    uint32_t sharpness = 0;
+    RejectReason reject_reason = RejectReason::None;
+    // Limiar de magnitude usado neste frame (o escolhido, nos modos adaptativos).
+    int threshold = 0;
+    // 1 bit por pixel; o mapa ASCII sai de AsciiRenderer::render(edge_mask) quando necessario.
+    EdgeMask edge_mask;
+    // Magnitude (int)sqrt(gx^2+gy^2) por pixel (w*h, borda 0). So preenchido com setGradientOutput(true).
+    std::vector<uint16_t> gradient_magnitude;
+    // Modos por tile: tiles_x colunas de tiles, tiles_total no frame.
+    int tiles_x = 0;
+    int tiles_total = 0;
+    // Modo incremental: tiles que vieram do cache sem recalcular.
+    int tiles_reused = 0;
+    // Modo piramidal: tiles analisados em resolucao cheia (1 por tile, em ordem de linha).
+    int tiles_refined = 0;
+    std::vector<uint8_t> refined_tiles;
+    // Trechos de fissura (componentes conexos da mascara), so com setSegmentation(true).
+    std::vector<CrackSegment> segments;
+    int segments_dropped = 0;   // componentes menores que o minimo, descartados como ruido
+    // Direcao das bordas, so com setOrientationOutput(true): soma de |gx|+|gy| dos pixels de borda
+    // em 16 bins de 11.25 graus (ver orientationBin). dominant_direction_deg e o centro do bin mais
+    // pesado em graus inteiros (0 = horizontal, 90 = vertical), ou -1 sem bordas.
+    uint64_t orientation_histogram[kOrientationBins] = {};
+    int dominant_direction_deg = -1;
 };
 
 class EdgeProcessor {
 public:
-    AnalysisResult analyze(const ImageFrame& frame);
-};
\ No newline at end of file
+    EdgeProcessor() : kernels(&bestEdgeKernels()) {}
+
+    // Forca um conjunto de kernels (ex.: escalar como referencia). Devolve false se a CPU nao suporta.
+    bool setKernels(KernelIsa isa) {
+        const EdgeKernels* k = edgeKernelsFor(isa);
+        if (!k) return false;
+        kernels = k;
+        return true;
+    }
+
+    const EdgeKernels& activeKernels() const { return *kernels; }
+
+    // Modo paralelo: o frame e dividido em faixas horizontais, uma por thread.
+    // 1 (padrao) mantem o caminho serial, sem criar threads.
+    void setThreadCount(int threads) {
+        if (threads < 1) threads = 1;
+        if (threads == threadCount()) return;
+        pool = threads > 1 ? std::make_unique<WorkerPool>(threads) : nullptr;
+    }
+
+    int threadCount() const { return pool ? pool->size() : 1; }
+
+    // Metrica usada para decidir borda; L2 (padrao) e exata, L1/LInf sao triagens mais baratas.
+    void setMagnitudeMode(MagnitudeMode mode) { magnitudeMode = mode; }
+    MagnitudeMode getMagnitudeMode() const { return magnitudeMode; }
+
+    // Operador de gradiente (Sobel por padrao). O limiar fica na escala do operador escolhido.
+    void setGradientOperator(GradientOperator op) { gradientOperator = op; }
+    GradientOperator getGradientOperator() const { return gradientOperator; }
+
+    // Limiar fixo de magnitude (padrao 100): borda quando magnitude > threshold.
+    void setThreshold(int threshold) { fixedThreshold = threshold; }
+
+    // Limiar adaptativo: o gradiente grava um nivel de 8 bits por pixel (ver levelRow em
+    // EdgeKernels.h) e, ao fim de cada faixa, levelHistogram conta o buffer de niveis da faixa. O
+    // nivel de corte sai do histograma (Otsu, ou o percentil dado em Percentile) e um segundo passo
+    // barato gera a mascara a partir dos niveis; a contagem de bordas sai do proprio histograma.
+    // Os limites possiveis sao os dos niveis: passos de 4 no L1/LInf (exatos: igual ao modo Fixed
+    // com setThreshold(result.threshold)) e multiplos de 1024 na metrica quadratica do L2
+    // (magnitude 32 a 511). Custo medido no EdgeBenchmark (QVGA a UXGA): 4-11% sobre o modo Fixed
+    // com SSE2; com AVX2 fica abaixo do proprio Fixed.
+    // Os modos incremental e piramidal sao ignorados fora do modo Fixed.
+    void setThresholdMode(ThresholdMode mode, int percentile = 95) {
+        thresholdMode = mode;
+        thresholdPercentile = percentile;
+    }
+    ThresholdMode getThresholdMode() const { return thresholdMode; }
+
+    // Quando ligado, analyze() tambem devolve a magnitude verdadeira de cada pixel.
+    void setGradientOutput(bool enabled) { gradientOutput = enabled; }
+
+    // Aceita qualquer ImageView (recorte, buffer com padding); ImageFrame converte implicitamente.
+    AnalysisResult analyze(const ImageView& image);
+
+    // Modo incremental para cenas paradas: o frame e dividido em tiles de tileSize x tileSize
+    // (arredondado para multiplo de 64) e tiles cujo conteudo, com 2 pixels de halo, nao mudou
+    // desde o ultimo frame reaproveitam mascara e contagem. Ignorado com setGradientOutput(true).
+    void setIncremental(bool enabled, int tileSize = 64);
+
+    // Modo piramidal (coarse-to-fine): um passo barato em blocos de 4 linhas mede o contraste local
+    // (max - min, sem blur nem gradiente, numa janela que contem a 5x5 do blur + gradiente de cada
+    // pixel) e so os tiles com contraste acima de guardThreshold sao analisados em resolucao cheia;
+    // nos demais a mascara fica vazia e a contagem e zero. Por ser max - min e nao media, uma
+    // fissura de 1 pixel mantem todo o seu contraste.
+    // A magnitude de um pixel e no maximo ganho x contraste (ganho 4 no Sobel, 16 no Scharr, 3 no
+    // Prewitt; x sqrt(2) no L2, x 2 no L1). A guarda automatica (-1) e o maior contraste que nao pode
+    // gerar borda: a densidade sai exata e so tiles lisos sao pulados. Uma guarda maior pula tambem
+    // textura fraca (troca precisao por velocidade): a densidade so pode sair menor que a exata, e o
+    // erro e no maximo a fracao do frame em tiles pulados com contraste acima da guarda automatica.
+    // Tem prioridade sobre o modo incremental e e ignorado com setGradientOutput(true).
+    void setPyramid(bool enabled, int guardThreshold = -1, int tileSize = 64);
+
+    // Agrupa os pixels de borda em trechos de fissura (CrackSegmenter) depois de cada analise;
+    // componentes com menos de minPixels pixels sao descartados como ruido.
+    void setSegmentation(bool enabled, int minPixels = 16) {
+        segmentation = enabled;
+        segmenter.setMinPixels(minPixels);
+    }
+
+    // Filtro de qualidade antes da analise: variancia do Laplaciano de 4 vizinhos em 1 de cada 4
+    // pixels, em x e em y (1/16 do frame). Frames borrados tem pouca energia de alta frequencia e
+    // dariam densidade de borda enganosamente baixa; abaixo de minSharpness o frame e descartado
+    // com reject_reason = Blurry. O valor depende da cena, da otica e da resolucao, entao nao ha
+    // limiar universal: com o padrao 0 o filtro so mede (result.sharpness) e nao descarta nada.
+    // Use calibrateSharpnessGate() na instalacao ou um limiar medido na propria cena.
+    void setSharpnessGate(bool enabled, uint32_t minSharpness = 0) {
+        sharpnessGate = enabled;
+        sharpnessMin = minSharpness;
+    }
+
+    // Calibra e liga o filtro com frames de referencia sabidamente nitidos da mesma cena, otica e
+    // resolucao da operacao: minSharpness = percent% da mediana da nitidez deles. Devolve o limiar.
+    uint32_t calibrateSharpnessGate(const std::vector<ImageView>& reference, uint32_t percent = 50);
+
+    // Frames vistos e descartados pelo filtro (somando os processadores de analyzeBatch).
+    QualityStats qualityStats() const;
+    void resetQualityStats();
+
+    // Modo so-alarme: antes do passo completo, avalia uma amostra estratificada (um pixel aleatorio
+    // por celula de uma grade 16x16, rodada apos rodada) e para assim que a densidade amostrada
+    // fica a mais de 3 desvios padrao do nivel de alarme (Q16, ex.: q16::fromRatio(1, 100) = 1%).
+    // Se a amostra esgota o orcamento sem decidir, faz o passo completo. Na saida antecipada a
+    // densidade e a estimativa, a mascara fica vazia e nao ha trechos nem histograma de direcao.
+    // So no modo Fixed e sem saida de magnitude; frames pequenos vao direto ao passo completo.
+    void setAlarmEstimate(bool enabled, uint32_t alarmDensityQ16 = 3277) {
+        alarmEstimate = enabled;
+        alarmDensity = alarmDensityQ16;
+    }
+
+    // Histograma de direcao das bordas no mesmo passo do gradiente: so os pixels marcados na mascara
+    // entram, com gx, gy recalculados das linhas borradas que ainda estao no cache. Vale nos modos
+    // completo, incremental (o histograma de cada tile fica no cache) e piramidal (tiles refinados);
+    // ignorado fora do modo Fixed, em que a mascara so sai depois do passo do gradiente.
+    void setOrientationOutput(bool enabled) { orientationOutput = enabled; }
+
+    // Lote de frames (ex.: replay de uma gravacao) em ordem de entrada. Com setThreadCount(n > 1)
+    // os frames sao distribuidos entre n processadores internos de uma thread cada (mesma
+    // configuracao deste), que ficam vivos entre lotes com os seus buffers; com 1 thread o lote
+    // roda aqui mesmo, reaproveitando o workspace.
+    std::vector<AnalysisResult> analyzeBatch(const ImageFrame* frames, size_t count);
+    std::vector<AnalysisResult> analyzeBatch(const std::vector<ImageFrame>& frames) {
+        return analyzeBatch(frames.data(), frames.size());
+    }
+
+    // Variante em fluxo: onResult(index, result) recebe cada resultado assim que ele e os anteriores
+    // ficam prontos, em ordem de entrada e uma chamada por vez (de qualquer thread do pool). O
+    // resultado so vale durante a chamada: os buffers voltam para um anel de 2 por thread, entao
+    // a memoria nao cresce com o tamanho do lote.
+    template <class Callback>
+    void analyzeBatch(const ImageFrame* frames, size_t count, const Callback& onResult) {
+        streamBatch(frames, count, &onResult, [](const void* callback, size_t index, const AnalysisResult& result) {
+            (*static_cast<const Callback*>(callback))(index, result);
+        });
+    }
+    template <class Callback>
+    void analyzeBatch(const std::vector<ImageFrame>& frames, const Callback& onResult) {
+        analyzeBatch(frames.data(), frames.size(), onResult);
+    }
+
+    // Versao que reaproveita os buffers de um resultado anterior. Junto com o workspace interno,
+    // um ciclo em regime (mesma resolucao) nao faz nenhuma alocacao no heap.
+    // O workspace e do processador: nao chamar analyze() de duas threads no mesmo objeto.
+    void analyze(const ImageView& image, AnalysisResult& result);
+
+private:
+    // Com levels != nullptr a faixa grava niveis (ver levelRow) em levels em vez de escrever a
+    // mascara; threshold e ignorado. Com orientation != nullptr soma a direcao das bordas da
+    // faixa em orientation[0..15].
+    void analyzeBand(const ImageView& image, int yBegin, int yEnd, int threshold,
+                     uint8_t* ring, EdgeMask& mask, uint16_t* magnitude,
+                     uint8_t* levels = nullptr, uint64_t* orientation = nullptr) const;
+
+    void analyzeWindow(const ImageView& image, int x0, int x1, int y0, int y1, int threshold,
+                       uint8_t* scratch, EdgeMask& mask, uint64_t* orientation = nullptr) const;
+
+    typedef void (*BatchCallback)(const void* callback, size_t index, const AnalysisResult& result);
+
+    void streamBatch(const ImageFrame* frames, size_t count, const void* callback, BatchCallback emit);
+    // Analisa frames[i] em slots[i % slotCount]; com emit, entrega em ordem e so reusa um slot ja entregue.
+    void runBatch(const ImageFrame* frames, size_t count, AnalysisResult* slots, size_t slotCount,
+                  const void* callback, BatchCallback emit);
+    void configureLane(EdgeProcessor& lane) const;
+
+    // Devolve false (sem mexer na mascara) quando a amostra nao decide o alarme.
+    bool estimateAlarm(const ImageView& image, int threshold, AnalysisResult& result);
+    bool sampleEdge(const ImageView& image, int x, int y, int threshold) const;
+
+    void analyzeFull(const ImageView& image, int threshold, AnalysisResult& result);
+    // Devolve os pixels de borda, que saem do histograma (sem popcount da mascara).
+    long analyzeAdaptive(const ImageView& image, uint16_t* magnitude, AnalysisResult& result);
+    void analyzeIncremental(const ImageView& image, int threshold, AnalysisResult& result);
+    void analyzePyramid(const ImageView& image, int threshold, AnalysisResult& result);
+
+    // Garante espaco de rascunho para `bands` faixas de largura w; so cresce, nunca encolhe.
+    void reserveWorkspace(int w, int bands);
+
+    const EdgeKernels* kernels;
+    std::unique_ptr<WorkerPool> pool;
+    MagnitudeMode magnitudeMode = MagnitudeMode::L2;
+    GradientOperator gradientOperator = GradientOperator::Sobel;
+    bool gradientOutput = false;
+    bool orientationOutput = false;
+    int fixedThreshold = 100;
+    ThresholdMode thresholdMode = ThresholdMode::Fixed;
+    int thresholdPercentile = 95;
+
+    bool segmentation = false;
+    CrackSegmenter segmenter;
+
+    // Lotes: processadores de uma thread por tarefa e anel de resultados da variante em fluxo.
+    std::vector<std::unique_ptr<EdgeProcessor>> batchLanes;
+    std::vector<AnalysisResult> batchSlots;
+    std::vector<uint8_t> batchDone;
+
+    bool sharpnessGate = false;
+    uint32_t sharpnessMin = 0;
+    QualityStats stats;
+
+    bool alarmEstimate = false;
+    uint32_t alarmDensity = 3277;      // 5% em Q16
+    uint32_t sampleState = 0x9E3779B9; // xorshift32 da amostragem
+
+    // Limiar adaptativo: niveis de magnitude do frame e 4 histogramas de 256 posicoes por faixa.
+    std::vector<uint8_t> levelBuffer;
+    std::vector<uint32_t> histograms;
+
+    // Histogramas de direcao: 16 bins por faixa (modo completo) ou por tile (piramidal).
+    std::vector<uint64_t> orientationBins;
+
+    // Por faixa: anel de 3 linhas borradas + linha temporaria, cada linha alinhada em 64 bytes.
+    std::vector<uint8_t, AlignedAllocator<uint8_t>> workspace;
+    int ringStride = 0;
+
+    // Cache do modo incremental (um item por tile).
+    bool incremental = false;
+    int tileSize = 64;
+    EdgeMask tileMask;
+    std::vector<uint64_t> tileHashes;
+    std::vector<int> tileCounts;
+    std::vector<uint8_t> tileValid;
+    std::vector<uint8_t> tileReused;
+    std::vector<uint64_t> tileOrientation;
+    int cachedThreshold = -1;
+    MagnitudeMode cachedMode = MagnitudeMode::L2;
+    GradientOperator cachedOperator = GradientOperator::Sobel;
+    bool cachedOrientation = false;
+
+    // Estado do modo piramidal.
+    bool pyramid = false;
+    int pyramidGuard = -1;
+    int pyramidTileSize = 64;
+    std::vector<int> pyramidCounts;
+};
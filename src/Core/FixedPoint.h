@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Ponto fixo Q16 (valor * 65536 em inteiro), usado no caminho sem float do ESP32.
+namespace q16 {
+
+constexpr uint32_t One = 1u << 16;
+
+// num / den truncado para Q16; den 0 vale 0.
+inline uint32_t fromRatio(uint64_t num, uint64_t den) {
+    return den ? (uint32_t)((num << 16) / den) : 0;
+}
+
+// Texto decimal com `decimals` casas (arredondado para o mais proximo), sem ponto flutuante.
+inline std::string format(uint32_t q, int decimals) {
+    uint64_t scale = 1;
+    for (int i = 0; i < decimals; i++) scale *= 10;
+    uint64_t scaled = ((uint64_t)q * scale + One / 2) >> 16;
+
+    std::string text = std::to_string(scaled / scale);
+    if (decimals > 0) {
+        std::string frac = std::to_string(scaled % scale);
+        text += '.';
+        text.append((size_t)decimals - frac.size(), '0');
+        text += frac;
+    }
+    return text;
+}
+
+}
@@ -18,23 +18,53 @@ struct SensorData {
 
 class PacketBuilder {
 public:
+    // capturedAt: hora da captura do frame (ex.: AsyncCapture::capturedAt()); 0 = agora.
     static std::string build(const std::string& deviceId, 
                              const SensorData& sensors, 
-                             const AnalysisResult& analysis) {
+                             const AnalysisResult& analysis,
+                             std::time_t capturedAt = 0) {
         
         std::stringstream ss;
         ss << "{\n";
         ss << "  \"device_id\": \"" << deviceId << "\",\n";
-        ss << "  \"timestamp\": \"" << getISOTimestamp() << "\",\n";
+        ss << "  \"timestamp\": \"" << getISOTimestamp(capturedAt ? capturedAt : std::time(nullptr)) << "\",\n";
         ss << "  \"imu\": {\n";
         ss << "    \"ax\": " << sensors.imu.ax << ", \"ay\": " << sensors.imu.ay << ", \"az\": " << sensors.imu.az << "\n";
         ss << "  },\n";
         ss << "  \"distance_mm\": " << sensors.distance_mm << ",\n";
         ss << "  \"light_lux\": " << sensors.light_lux << ",\n";
         ss << "  \"analysis\": {\n";
+#ifdef EDGE_FIXED_POINT
+        // Sem float: os valores saem dos campos Q16 com 4 casas, formatados em inteiro.
+        ss << "    \"edge_density\": " << q16::format(analysis.edge_density_q16, 4) << ",\n";
+        ss << "    \"confidence\": " << q16::format(analysis.confidence_q16, 4) << ",\n";
+#else
         ss << "    \"edge_density\": " << std::fixed << std::setprecision(4) << analysis.edge_density << ",\n";
         ss << "    \"confidence\": " << analysis.confidence << ",\n";
+#endif
         ss << "    \"process_time_ms\": " << analysis.process_time_ms << ",\n";
+        ss << "    \"reject_reason\": \"" << rejectReasonName(analysis.reject_reason)
+           << "\", \"sharpness\": " << analysis.sharpness << ",\n";
+        ss << "    \"alarm\": " << (analysis.alarm ? "true" : "false")
+           << ", \"sampled_pixels\": " << analysis.sampled_pixels << ",\n";
+        ss << "    \"segments\": [";
+        for (size_t i = 0; i < analysis.segments.size(); i++) {
+            const CrackSegment& seg = analysis.segments[i];
+            ss << (i ? ", " : "") << "{\"x\": " << seg.x0 << ", \"y\": " << seg.y0
+               << ", \"w\": " << seg.x1 - seg.x0 + 1 << ", \"h\": " << seg.y1 - seg.y0 + 1
+               << ", \"pixels\": " << seg.pixels << ", \"extent\": " << seg.extent << "}";
+        }
+        ss << "],\n";
+        // Histograma de direcao normalizado em por mil (independe da resolucao e cabe em inteiros).
+        uint64_t orientationTotal = 0;
+        for (uint64_t weight : analysis.orientation_histogram) orientationTotal += weight;
+        ss << "    \"orientation_permille\": [";
+        for (int i = 0; i < kOrientationBins; i++) {
+            uint64_t weight = analysis.orientation_histogram[i];
+            ss << (i ? ", " : "") << (orientationTotal ? weight * 1000 / orientationTotal : 0);
+        }
+        ss << "],\n";
+        ss << "    \"dominant_direction_deg\": " << analysis.dominant_direction_deg << ",\n";
         ss << "    \"algorithm\": \"sobel_v1\"\n";
         ss << "  }\n";
         ss << "}";
@@ -42,11 +72,25 @@ public:
         return ss.str();
     }
 
+    // Pacote minimo para ciclos sem mudanca de cena (ChangeDetector): o backend sabe que o node
+    // esta vivo e que a ultima analise completa (last) continua valendo, sem o pacote inteiro.
+    static std::string heartbeat(const std::string& deviceId, const AnalysisResult& last, int unchangedCycles) {
+        std::stringstream ss;
+        ss << "{\"device_id\": \"" << deviceId << "\", \"timestamp\": \"" << getISOTimestamp(std::time(nullptr))
+           << "\", \"heartbeat\": true, \"unchanged_cycles\": " << unchangedCycles << ", \"edge_density\": ";
+#ifdef EDGE_FIXED_POINT
+        ss << q16::format(last.edge_density_q16, 4);
+#else
+        ss << std::fixed << std::setprecision(4) << last.edge_density;
+#endif
+        ss << "}";
+        return ss.str();
+    }
+
 private:
-    static std::string getISOTimestamp() {
-        std::time_t now = std::time(nullptr);
+    static std::string getISOTimestamp(std::time_t when) {
         char buf[25];
-        std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+        std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&when));
         return std::string(buf);
     }
 };
\ No newline at end of file
@@ -0,0 +1,99 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Pool fixo de threads para dividir um trabalho em tarefas independentes.
+// run() bloqueia ate todas as tarefas terminarem; a thread chamadora tambem executa tarefas,
+// entao um pool de N threads cria apenas N-1 workers. Nao e reentrante: um run() por vez.
+// A tarefa e passada por referencia (sem std::function), entao run() nao aloca memoria.
+class WorkerPool {
+public:
+    explicit WorkerPool(int threads) {
+        for (int i = 1; i < threads; i++) {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& t : workers) t.join();
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    int size() const { return (int)workers.size() + 1; }
+
+    template <class Task>
+    void run(int tasks, const Task& task) {
+        if (workers.empty() || tasks <= 1) {
+            for (int i = 0; i < tasks; i++) task(i);
+            return;
+        }
+        runShared(tasks, &task, [](const void* t, int i) { (*static_cast<const Task*>(t))(i); });
+    }
+
+private:
+    typedef void (*Trampoline)(const void* task, int index);
+
+    void runShared(int tasks, const void* task, Trampoline call) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = task;
+            jobCall = call;
+            jobTasks = tasks;
+            next = 0;
+            pending = (int)workers.size();
+            generation++;
+        }
+        wake.notify_all();
+
+        drain();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this] { return pending == 0; });
+        job = nullptr;
+    }
+
+    void drain() {
+        for (int i = next.fetch_add(1); i < jobTasks; i = next.fetch_add(1)) {
+            jobCall(job, i);
+        }
+    }
+
+    void workerLoop() {
+        unsigned seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+
+            lock.unlock();
+            drain();
+            lock.lock();
+
+            if (--pending == 0) idle.notify_one();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+
+    const void* job = nullptr;
+    Trampoline jobCall = nullptr;
+    int jobTasks = 0;
+    std::atomic<int> next{0};
+    int pending = 0;
+    unsigned generation = 0;
+    bool stopping = false;
+};
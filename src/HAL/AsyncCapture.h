@@ -0,0 +1,150 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <mutex>
+#include <thread>
+#include "ICamera.h"
+
+// Captura em segundo plano sobre qualquer ICamera: enquanto o chamador analisa o frame k, uma
+// thread propria ja captura o frame k+1, e o ciclo passa de captura + analise para o maior dos dois.
+// acquire() entrega o frame pronto (espera so se a captura ainda nao terminou) e dispara a
+// proxima captura na hora. O frame entregue e um FrameLease: devolve-lo e destrui-lo ou chamar
+// reset(). Com o pool padrao de 2 buffers o chamador pode segurar 1 frame enquanto o proximo e
+// capturado; segurando frameBuffers() frames, a captura falha e acquire() devolve um lease
+// invalido, como capture(). A captura que falhou e descartada: a acquire() seguinte pede outra.
+// Com prefetch o frame entregue foi capturado no inicio do ciclo anterior, e depois de uma pausa
+// longa tem a idade da pausa; setPrefetch(false) + request() perto do fim da pausa evita isso.
+// Um consumidor so; a camera nao pode ser usada direto enquanto a captura assincrona roda, e
+// precisa viver mais que este objeto.
+class AsyncCapture {
+public:
+    explicit AsyncCapture(ICamera& camera) : camera(camera) {}
+    ~AsyncCapture() { stop(); }
+
+    AsyncCapture(const AsyncCapture&) = delete;
+    AsyncCapture& operator=(const AsyncCapture&) = delete;
+
+    // Sobe a thread e, com prefetch, ja pede o primeiro frame.
+    void start() {
+        if (worker.joinable()) return;
+        stopping = false;
+        ready = false;
+        requested = prefetch;
+        inFlight = prefetch;
+        worker = std::thread([this] { captureLoop(); });
+    }
+
+    // true (padrao): acquire() pede o proximo frame assim que entrega o atual. false: a captura so
+    // comeca em request(), ou na propria acquire() (que entao espera a captura inteira).
+    void setPrefetch(bool enabled) {
+        std::lock_guard<std::mutex> lock(mutex);
+        prefetch = enabled;
+    }
+
+    // Pede a captura do proximo frame agora (nada se ja ha um pedido ou um frame pronto).
+    void request() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (ready || inFlight) return;
+            requested = true;
+            inFlight = true;
+        }
+        wake.notify_one();
+    }
+
+    // Sem start(), captura sincrona na thread do chamador.
+    FrameLease acquire() {
+        if (!worker.joinable()) {
+            FrameLease frame = camera.capture();
+            if (frame.valid()) lastCapture = std::time(nullptr);
+            return frame;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!ready) {
+            if (!inFlight) {
+                // Sem pedido em andamento (sem prefetch, ou a ultima captura falhou): pede agora.
+                requested = true;
+                inFlight = true;
+                wake.notify_one();
+            }
+            auto begin = std::chrono::steady_clock::now();
+            captured.wait(lock, [this] { return ready; });
+            waitedUs += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count();
+        }
+        FrameLease frame = std::move(pending);
+        ready = false;
+        if (!frame.valid()) return frame;   // descartada; a proxima acquire() tenta de novo
+
+        lastCapture = pendingCapture;
+        acquired++;
+        if (prefetch) {
+            requested = true;
+            inFlight = true;
+            lock.unlock();
+            wake.notify_one();
+        }
+        return frame;
+    }
+
+    // Para a thread (esperando a captura em andamento) e devolve o frame ja capturado.
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        if (worker.joinable()) worker.join();
+        pending.reset();
+        ready = false;
+        inFlight = false;
+    }
+
+    bool running() const { return worker.joinable(); }
+
+    // Frames entregues e tempo total que acquire() ficou esperando a captura: perto de zero quando
+    // a analise e mais lenta que a captura (a captura fica toda escondida).
+    long framesAcquired() const { return acquired; }
+    long long waitedMicros() const { return waitedUs; }
+
+    // Hora (relogio de parede) em que o ultimo frame entregue foi capturado: o carimbo do pacote.
+    std::time_t capturedAt() const { return lastCapture; }
+
+private:
+    void captureLoop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            wake.wait(lock, [this] { return stopping || requested; });
+            if (stopping) return;
+            requested = false;
+            lock.unlock();
+
+            FrameLease frame = camera.capture();
+            std::time_t when = std::time(nullptr);
+
+            lock.lock();
+            pending = std::move(frame);
+            pendingCapture = when;
+            ready = true;
+            inFlight = false;
+            captured.notify_one();
+        }
+    }
+
+    ICamera& camera;
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;       // thread de captura: proximo frame pedido
+    std::condition_variable captured;   // chamador: frame pronto
+    FrameLease pending;
+    bool ready = false;
+    bool requested = false;
+    bool inFlight = false;   // captura pedida ou em andamento
+    bool prefetch = true;
+    bool stopping = false;
+    std::time_t pendingCapture = 0;
+    std::time_t lastCapture = 0;
+    long acquired = 0;
+    long long waitedUs = 0;
+};
@@ -23,7 +23,7 @@
 class EspCamera : public ICamera {
 public:
     bool init() override {
-        camera_config_t config;
+        camera_config_t config = {};
         config.ledc_channel = LEDC_CHANNEL_0;
         config.ledc_timer = LEDC_TIMER_0;
         config.pin_d0 = Y2_GPIO_NUM;
@@ -48,12 +48,21 @@ public:
         if(psramFound()){
             config.frame_size = FRAMESIZE_UXGA;
             config.jpeg_quality = 10;
-            config.fb_count = 2;
+            // Os frames entregues sao os proprios fb do driver (sem copia), entao os buffers da camera
+            // sao os fb: frameBuffers() fb na PSRAM (1.9 MB cada em UXGA) e nenhum buffer no pool.
+            // Com mais de um fb, LATEST entrega o mais novo, e nao um frame parado na fila desde o
+            // ciclo anterior; com um so (setFrameBuffers(1), o que cabe ao lado da analise), o driver
+            // enche o fb assim que ele volta, e capture() descarta esse frame velho.
+            config.fb_count = frameBuffers();
+            config.grab_mode = frameBuffers() > 1 ? CAMERA_GRAB_LATEST : CAMERA_GRAB_WHEN_EMPTY;
         } else {
             config.frame_size = FRAMESIZE_QVGA;
             config.jpeg_quality = 12;
             config.fb_count = 1;
+            config.grab_mode = CAMERA_GRAB_WHEN_EMPTY;
+            framePool.reserve(1, 0);
         }
+        flushStale = config.fb_count == 1;
 
         esp_err_t err = esp_camera_init(&config);
         if (err != ESP_OK) {
@@ -68,28 +77,29 @@ public:
         return true;
     }
 
-    ImageFrame capture() override {
-        ImageFrame frame;
+    FrameLease capture() override {
         camera_fb_t * fb = esp_camera_fb_get();
+        if (fb && flushStale) {
+            // Fb unico: o frame pronto foi gravado quando o fb voltou, talvez um ciclo atras.
+            esp_camera_fb_return(fb);
+            fb = esp_camera_fb_get();
+        }
         
         if (!fb) {
             Serial.println("Camera capture failed");
-            frame.valid = false;
-            return frame;
+            return FrameLease();
         }
 
-        frame.width = fb->width;
-        frame.height = fb->height;
-        frame.valid = true;
-        frame.data.assign(fb->buf, fb->buf + fb->len);
-        
-        esp_camera_fb_return(fb); 
+        // O lease aponta para o buffer DMA do driver e devolve o fb (esp_camera_fb_return) quando e
+        // solto. Com todos os fb emprestados, esp_camera_fb_get falha e a captura devolve lease invalido.
+        FrameLease frame = FrameLease::borrow(ImageView(fb->buf, fb->width, fb->height, fb->width), returnFrame, fb);
+        if (!frame.valid()) frame.reset();
         
         return frame;
     }
 
-    void returnFrame(ImageFrame& frame) override {
-        frame.data.clear();
-        frame.valid = false;
-    }
+private:
+    static void returnFrame(void* fb) { esp_camera_fb_return(static_cast<camera_fb_t*>(fb)); }
+
+    bool flushStale = false;
 };
\ No newline at end of file
@@ -0,0 +1,203 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include "ImageView.h"
+#include "../Core/AlignedAllocator.h"
+
+class FrameBufferPool;
+
+// Frame emprestado de um FrameBufferPool (so move, nao copia). O buffer volta para o pool quando o
+// lease e destruido ou em reset(); o pool precisa viver mais que os seus leases.
+// Quem preenche (a camera) chama setFrame() com as dimensoes do conteudo (stride = largura).
+class FrameLease {
+public:
+    FrameLease() = default;
+    ~FrameLease() { reset(); }
+
+    // Lease sem buffer do pool, so leitura, sobre pixels de outro dono (ex.: o cache decodificado
+    // da FileCamera): sem copia, data() e nullptr e a memoria precisa viver mais que o lease.
+    static FrameLease borrow(const ImageView& view) {
+        FrameLease lease;
+        lease.source = view.data;
+        lease.frameWidth = view.data ? view.width : 0;
+        lease.frameHeight = view.data ? view.height : 0;
+        lease.frameStride = view.stride;
+        return lease;
+    }
+
+    // Como borrow(), mas o dono recebe a memoria de volta: release(context) roda uma vez, quando o
+    // lease e destruido ou em reset() (ex.: o fb do driver da camera, devolvido sem copia).
+    static FrameLease borrow(const ImageView& view, void (*release)(void*), void* context) {
+        FrameLease lease = borrow(view);
+        lease.onRelease = release;
+        lease.releaseContext = context;
+        return lease;
+    }
+
+    FrameLease(FrameLease&& other) noexcept { moveFrom(other); }
+    FrameLease& operator=(FrameLease&& other) noexcept {
+        if (this != &other) {
+            reset();
+            moveFrom(other);
+        }
+        return *this;
+    }
+    FrameLease(const FrameLease&) = delete;
+    FrameLease& operator=(const FrameLease&) = delete;
+
+    // Lease com buffer (ou emprestado) e com um frame preenchido.
+    bool valid() const { return (pool != nullptr || source != nullptr) && frameWidth > 0; }
+
+    uint8_t* data() { return buffer; }
+    const uint8_t* data() const { return buffer; }
+    size_t capacity() const { return bytes; }
+    int width() const { return frameWidth; }
+    int height() const { return frameHeight; }
+
+    // Descreve o conteudo escrito em data(); false se nao cabe no buffer.
+    bool setFrame(int width, int height) {
+        if (!buffer || width <= 0 || height <= 0 || (size_t)width * height > bytes) return false;
+        frameWidth = width;
+        frameHeight = height;
+        frameStride = width;
+        return true;
+    }
+
+    ImageView view() const {
+        return source ? ImageView(source, frameWidth, frameHeight, frameStride)
+                      : ImageView(buffer, frameWidth, frameHeight, frameWidth);
+    }
+    operator ImageView() const { return view(); }
+
+    // Devolve o buffer agora (o lease fica invalido).
+    inline void reset();
+
+private:
+    friend class FrameBufferPool;
+    FrameLease(FrameBufferPool* pool, int index, uint8_t* buffer, size_t bytes)
+        : pool(pool), index(index), buffer(buffer), bytes(bytes) {}
+
+    void moveFrom(FrameLease& other) {
+        pool = other.pool;
+        index = other.index;
+        buffer = other.buffer;
+        bytes = other.bytes;
+        frameWidth = other.frameWidth;
+        frameHeight = other.frameHeight;
+        frameStride = other.frameStride;
+        source = other.source;
+        onRelease = other.onRelease;
+        releaseContext = other.releaseContext;
+        other.pool = nullptr;
+        other.onRelease = nullptr;
+        other.buffer = nullptr;
+        other.source = nullptr;
+        other.frameWidth = 0;
+        other.frameHeight = 0;
+    }
+
+    FrameBufferPool* pool = nullptr;
+    int index = -1;
+    uint8_t* buffer = nullptr;
+    size_t bytes = 0;
+    int frameWidth = 0;
+    int frameHeight = 0;
+    int frameStride = 0;
+    const uint8_t* source = nullptr;
+    void (*onRelease)(void*) = nullptr;
+    void* releaseContext = nullptr;
+};
+
+// Pool de capacidade fixa de buffers de frame alinhados (64 bytes), alocados uma vez num bloco so.
+// acquire() nao aloca: devolve um lease invalido quando todos os buffers estao emprestados, o que
+// limita os frames em voo. Pode ser usado de varias threads (acquire e devolucao sob mutex).
+class FrameBufferPool {
+public:
+    explicit FrameBufferPool(int buffers = 2, size_t bytesPerBuffer = 0) { reserve(buffers, bytesPerBuffer); }
+
+    FrameBufferPool(const FrameBufferPool&) = delete;
+    FrameBufferPool& operator=(const FrameBufferPool&) = delete;
+
+    // Redimensiona o pool; so e possivel com todos os buffers livres (false se ha leases em voo).
+    bool reserve(int buffers, size_t bytesPerBuffer) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return reserveLocked(buffers, bytesPerBuffer);
+    }
+
+    // Um buffer de pelo menos `bytes` bytes. Se os buffers atuais sao menores, o pool cresce
+    // (alocacao unica, ex.: primeiro frame de uma resolucao maior), mas so se nenhum esta emprestado.
+    FrameLease acquire(size_t bytes) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (bytes > bufferBytes && !reserveLocked(count, bytes)) return FrameLease();
+        return acquireLocked();
+    }
+
+    FrameLease acquire() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return acquireLocked();
+    }
+
+    // Chamado (fora do mutex do pool) a cada buffer devolvido, de qualquer thread: quem precisa
+    // esperar um buffer livre espera numa condicao propria, sinalizada aqui, em vez de sondar.
+    void setReleaseListener(std::function<void()> listener) { releaseListener = std::move(listener); }
+
+    int capacity() const { return count; }
+    size_t bytesPerBuffer() const { return bufferBytes; }
+    int available() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return (int)freeList.size();
+    }
+
+private:
+    friend class FrameLease;
+
+    bool reserveLocked(int buffers, size_t bytesPerBuffer) {
+        if ((int)freeList.size() != count) return false;
+        count = buffers > 0 ? buffers : 1;
+        bufferBytes = bytesPerBuffer;
+        stride = (bytesPerBuffer + 63) & ~(size_t)63;
+        storage.assign(stride * count, 0);
+        storage.shrink_to_fit();
+        freeList.clear();
+        freeList.reserve(count);
+        for (int i = count - 1; i >= 0; i--) freeList.push_back(i);
+        return true;
+    }
+
+    FrameLease acquireLocked() {
+        if (freeList.empty()) return FrameLease();
+        int index = freeList.back();
+        freeList.pop_back();
+        return FrameLease(this, index, storage.data() + stride * index, bufferBytes);
+    }
+
+    void release(int index) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            freeList.push_back(index);
+        }
+        if (releaseListener) releaseListener();
+    }
+
+    std::mutex mutex;
+    std::vector<uint8_t, AlignedAllocator<uint8_t>> storage;
+    std::vector<int> freeList;
+    std::function<void()> releaseListener;
+    size_t bufferBytes = 0;
+    size_t stride = 0;
+    int count = 0;
+};
+
+inline void FrameLease::reset() {
+    if (pool) pool->release(index);
+    if (onRelease) onRelease(releaseContext);
+    pool = nullptr;
+    onRelease = nullptr;
+    buffer = nullptr;
+    source = nullptr;
+    frameWidth = 0;
+    frameHeight = 0;
+}
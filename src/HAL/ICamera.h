@@ -1,18 +1,34 @@
 #pragma once
 #include <cstdint>
 #include <vector>
+#include "FrameBufferPool.h"
+#include "ImageView.h"
 
+// Frame dono dos proprios pixels (testes, lotes gravados). As cameras entregam FrameLease.
 struct ImageFrame {
     std::vector<uint8_t> data;
     int width;
     int height;
     bool valid = false;
+
+    // Conversao implicita: quem recebe ImageView aceita um ImageFrame direto.
+    operator ImageView() const { return ImageView(data.data(), width, height, width); }
 };
 
 class ICamera {
 public:
     virtual ~ICamera() = default;
     virtual bool init() = 0;
-    virtual ImageFrame capture() = 0;
-    virtual void returnFrame(ImageFrame& frame) = 0; 
-};
\ No newline at end of file
+
+    // Preenche um buffer do pool da camera; o buffer volta ao pool quando o lease e destruido.
+    // Lease invalido se a captura falha ou se todos os buffers estao emprestados, entao os frames
+    // em voo nunca passam de frameBuffers(). Em regime (mesma resolucao) nao aloca no heap.
+    virtual FrameLease capture() = 0;
+
+    // Quantos frames podem estar emprestados ao mesmo tempo (padrao 2); so muda sem leases em voo.
+    bool setFrameBuffers(int count) { return framePool.reserve(count, framePool.bytesPerBuffer()); }
+    int frameBuffers() const { return framePool.capacity(); }
+
+protected:
+    FrameBufferPool framePool{2};
+};
@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+
+// Visao nao-proprietaria de uma imagem em escala de cinza: ponteiro, dimensoes e stride (bytes por linha).
+// Serve para analisar recortes (ROI), buffers com padding da camera ou trechos de um mosaico sem copiar.
+struct ImageView {
+    const uint8_t* data = nullptr;
+    int width = 0;
+    int height = 0;
+    int stride = 0;
+
+    ImageView() = default;
+    ImageView(const uint8_t* data, int width, int height, int stride)
+        : data(data), width(width), height(height), stride(stride) {}
+    ImageView(const uint8_t* data, int width, int height)
+        : ImageView(data, width, height, width) {}
+
+    const uint8_t* row(int y) const { return data + (long)y * stride; }
+
+    uint8_t at(int x, int y) const { return row(y)[x]; }
+
+    // Sub-retangulo; o chamador garante que [x, x+w) x [y, y+h) esta dentro da visao.
+    ImageView crop(int x, int y, int w, int h) const {
+        return ImageView(row(y) + x, w, h, stride);
+    }
+};
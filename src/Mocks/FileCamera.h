@@ -1,19 +1,64 @@
 #pragma once
 #include "../HAL/ICamera.h"
+#include <algorithm>
 #include <iostream>
 #include <string>
+#include "ImageDecoder.h"   // stb_image + decodificacao reduzida
 
-// Definição necessária para ativar a implementação da biblioteca
-#define STB_IMAGE_IMPLEMENTATION
-#include "../stb_image.h" // O arquivo que acabamos de baixar
+// Perturbacoes baratas por frame para o modo cache, para que caches (modo incremental) e
+// detectores de mudanca nao vejam sempre o mesmo frame. Todas sorteadas a cada captura.
+struct FramePerturbation {
+    int maxShift = 0;      // deslocamento de ate +-maxShift pixels em x e y (recorte do cache, sem copia)
+    int noise = 0;         // ruido de +-noise niveis por pixel
+    int gainPercent = 0;   // ganho de 100 +- gainPercent %
+    uint32_t seed = 1;
+};
 
 class FileCamera : public ICamera {
     std::string filepath;
 
+    // Modo cache: a imagem decodificada fica num buffer proprio, alinhado, ate o fim da camera.
+    bool cached = false;
+    FramePerturbation perturbation;
+    FrameBufferPool cachePool{1};
+    FrameLease cache;
+    std::vector<int8_t> noiseTable;
+    uint32_t rng = 1;
+
+    int requestedWidth = 0;
+    int requestedHeight = 0;
+
 public:
     // Construtor que aceita o nome do arquivo
     FileCamera(const std::string& path) : filepath(path) {}
 
+    // Modo cache para replay e benchmark: decodifica o arquivo uma vez so (na primeira captura) e
+    // sem log por frame. Sem perturbacao de pixel, capture() devolve um lease emprestado que aponta
+    // direto para o cache (sem copia, fora do limite de frames em voo); com noise ou gain, cada
+    // captura escreve o frame perturbado num buffer do pool em uma passada (LUT de ganho + tabela de ruido).
+    // Com maxShift o frame tem (w - 2*maxShift) x (h - 2*maxShift): o deslocamento e so um recorte.
+    void setCached(bool enabled, const FramePerturbation& frames = FramePerturbation()) {
+        cached = enabled;
+        perturbation = frames;
+        rng = frames.seed ? frames.seed : 1;
+        if (!enabled) cache.reset();
+        noiseTable.clear();
+        if (enabled && frames.noise > 0) {
+            // 64K amostras uniformes; cada frame comeca num ponto sorteado da tabela.
+            noiseTable.resize(65536);
+            for (auto& v : noiseTable) v = (int8_t)((int)(nextRandom() % (2 * frames.noise + 1)) - frames.noise);
+        }
+    }
+
+    // Resolucao pedida pela analise: a imagem e decodificada reduzida por 2, 4 ou 8 (a maior reducao
+    // que ainda entrega pelo menos width x height), JPEG direto do dominio da DCT, so a luma.
+    // 0 x 0 (padrao) = resolucao cheia. No modo cache vale a partir da proxima decodificacao.
+    void setRequestedResolution(int width, int height) {
+        requestedWidth = width;
+        requestedHeight = height;
+        cache.reset();
+    }
+
     bool init() override {
         // Verifica se o arquivo existe (tentativa simples)
         FILE* f = fopen(filepath.c_str(), "rb");
@@ -26,38 +71,103 @@ public:
         return false;
     }
 
-    ImageFrame capture() override {
-        ImageFrame frame;
-        int width, height, channels;
+    FrameLease capture() override {
+        if (cached) return captureCached();
+
+        int width, height;
 
-        // stbi_load carrega a imagem. 
-        // O último parâmetro '1' FORÇA a conversão para Escala de Cinza (Grayscale)
+        // Carrega a imagem ja em Escala de Cinza (Grayscale), na resolucao pedida.
         // Isso é perfeito porque o Sobel só trabalha com cinza.
-        unsigned char *img = stbi_load(filepath.c_str(), &width, &height, &channels, 1);
+        unsigned char *img = decode(&width, &height);
 
         if (img == NULL) {
             std::cerr << "[FILE_CAM] Falha ao decodificar a imagem.\n";
-            frame.valid = false;
+            return FrameLease();
+        }
+
+        // Copia os pixels para um buffer do pool, como o ESP32 faz a partir do buffer DMA
+        FrameLease frame = framePool.acquire((size_t)width * height);
+        if (frame.setFrame(width, height)) {
+            std::copy(img, img + (size_t)width * height, frame.data());
+            std::cout << "[FILE_CAM] Imagem carregada: " << width << "x" << height << "px\n";
         } else {
-            frame.width = width;
-            frame.height = height;
-            frame.valid = true;
+            std::cerr << "[FILE_CAM] Sem buffer livre no pool.\n";
+            frame.reset();
+        }
 
-            // Copia os dados brutos da biblioteca para o nosso vetor
-            // O ESP32 faria algo parecido lendo do buffer DMA
-            frame.data.assign(img, img + (width * height));
+        // Libera a memória alocada pela biblioteca stb
+        stbi_image_free(img);
 
-            // Libera a memória alocada pela biblioteca stb
-            stbi_image_free(img);
-            
-            std::cout << "[FILE_CAM] Imagem carregada: " << width << "x" << height << "px\n";
+        return frame;
+    }
+
+private:
+    uint32_t nextRandom() {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        return rng;
+    }
+
+    FrameLease captureCached() {
+        if (!cache.valid() && !decodeCache()) return FrameLease();
+
+        int shift = perturbation.maxShift;
+        ImageView source = cache.view();
+        if (2 * shift >= source.width || 2 * shift >= source.height) shift = 0;
+        int dx = shift ? (int)(nextRandom() % (2 * shift + 1)) : 0;
+        int dy = shift ? (int)(nextRandom() % (2 * shift + 1)) : 0;
+        ImageView view = source.crop(dx, dy, source.width - 2 * shift, source.height - 2 * shift);
+
+        if (perturbation.noise <= 0 && perturbation.gainPercent <= 0) return FrameLease::borrow(view);
+
+        FrameLease frame = framePool.acquire((size_t)view.width * view.height);
+        if (!frame.setFrame(view.width, view.height)) return FrameLease();
+
+        int gain = 100;
+        if (perturbation.gainPercent > 0) {
+            gain += (int)(nextRandom() % (2 * perturbation.gainPercent + 1)) - perturbation.gainPercent;
         }
+        uint8_t lut[256];
+        for (int v = 0; v < 256; v++) lut[v] = (uint8_t)std::min(255, v * gain / 100);
 
+        uint8_t* out = frame.data();
+        if (noiseTable.empty()) {
+            for (int y = 0; y < view.height; y++) {
+                const uint8_t* in = view.row(y);
+                for (int x = 0; x < view.width; x++) *out++ = lut[in[x]];
+            }
+        } else {
+            uint32_t k = nextRandom();
+            for (int y = 0; y < view.height; y++) {
+                const uint8_t* in = view.row(y);
+                for (int x = 0; x < view.width; x++) {
+                    int v = lut[in[x]] + noiseTable[k++ & 0xFFFF];
+                    *out++ = (uint8_t)(v < 0 ? 0 : v > 255 ? 255 : v);
+                }
+            }
+        }
         return frame;
     }
 
-    void returnFrame(ImageFrame& frame) override {
-        frame.data.clear();
-        frame.valid = false;
+    unsigned char* decode(int* width, int* height) {
+        int scale = ImageDecoder::scaleFor(filepath.c_str(), requestedWidth, requestedHeight);
+        return ImageDecoder::loadGray(filepath.c_str(), scale, width, height);
+    }
+
+    bool decodeCache() {
+        int width, height;
+        unsigned char* img = decode(&width, &height);
+        if (img == NULL) {
+            std::cerr << "[FILE_CAM] Falha ao decodificar a imagem.\n";
+            return false;
+        }
+        cachePool.reserve(1, (size_t)width * height);
+        cache = cachePool.acquire();
+        cache.setFrame(width, height);
+        std::copy(img, img + (size_t)width * height, cache.data());
+        stbi_image_free(img);
+        std::cout << "[FILE_CAM] Imagem decodificada uma vez (cache): " << width << "x" << height << "px\n";
+        return true;
     }
 };
\ No newline at end of file
@@ -0,0 +1,217 @@
+#pragma once
+#include <cstdio>
+#include <type_traits>
+#include <utility>
+
+// Definição necessária para ativar a implementação da biblioteca (uma vez so, aqui)
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_image.h"
+
+// Decodificacao direto para cinza, opcionalmente reduzida por 2, 4 ou 8.
+// JPEG (baseline ou progressivo) reduz no dominio da DCT: cada bloco 8x8 de luma vira 8/scale x
+// 8/scale pixels por uma IDCT reduzida sobre os coeficientes de baixa frequencia (aproxima a
+// media), e os blocos de croma sao so decodificados pelo Huffman (obrigatorio no fluxo
+// intercalado), sem IDCT, sem reamostragem e sem conversao de cor. Com scale 8 o pixel e o DC, a media exata do bloco.
+// A entropia (Huffman) continua inteira: e o piso do tempo de decodificacao.
+// Outros formatos (PNG, PGM, ...) e JPEGs sem luma na resolucao cheia (RGB Adobe, CMYK, croma
+// com mais amostras que a luma) decodificam inteiros e fazem media de blocos scale x scale.
+// O buffer devolvido e do stb: libere com stbi_image_free.
+//
+// A reducao na DCT usa a estrutura interna do decodificador JPEG do stb_image v2.30 (o vendorizado
+// em src/). O CMake confere a versao no cabecalho e define EDGE_STB_SCALED_JPEG=0 se mudou; alem
+// disso, se stbi__jpeg nao tem os campos usados, o caminho sai na compilacao. Nos dois casos todo
+// JPEG reduzido vai por stbi_load + boxReduce (mesmo resultado, mais lento).
+#ifndef EDGE_STB_SCALED_JPEG
+#define EDGE_STB_SCALED_JPEG 1
+#endif
+
+template <typename J, typename = void>
+struct StbJpegLayout : std::false_type {};
+
+template <typename J>
+struct StbJpegLayout<J, std::void_t<
+    decltype(std::declval<J&>().idct_block_kernel = std::declval<void (*)(stbi_uc*, int, short*)>()),
+    decltype(std::declval<J&>().img_comp[0].data + std::declval<J&>().img_comp[0].w2 * std::declval<J&>().img_comp[0].h2),
+    decltype(std::declval<J&>().img_comp[0].h + std::declval<J&>().img_comp[0].v),
+    decltype(std::declval<J&>().img_h_max + std::declval<J&>().img_v_max),
+    decltype(std::declval<J&>().rgb + std::declval<J&>().app14_color_transform + std::declval<J&>().jfif),
+    decltype(std::declval<J&>().s->img_n + std::declval<J&>().s->img_x + std::declval<J&>().s->img_y)>>
+    : std::true_type {};
+
+class ImageDecoder {
+public:
+    // Maior reducao (1, 2, 4 ou 8) que ainda entrega pelo menos requestedWidth x requestedHeight;
+    // 0 em um eixo nao limita aquele eixo. 1 se o arquivo nao for lido.
+    static int scaleFor(const char* path, int requestedWidth, int requestedHeight) {
+        int width, height, channels;
+        if ((requestedWidth <= 0 && requestedHeight <= 0) || !stbi_info(path, &width, &height, &channels)) return 1;
+        int scale = 1;
+        while (scale < 8 && reduced(width, scale * 2) >= requestedWidth && reduced(height, scale * 2) >= requestedHeight) {
+            scale *= 2;
+        }
+        return scale;
+    }
+
+    static unsigned char* loadGray(const char* path, int scale, int* width, int* height) {
+        int channels;
+        if (scale != 2 && scale != 4 && scale != 8) return stbi_load(path, width, height, &channels, 1);
+
+        unsigned char* img = loadJpegLuma<stbi__jpeg>(path, scale, width, height);
+        if (img) return img;
+
+        img = stbi_load(path, width, height, &channels, 1);
+        if (!img) return nullptr;
+        unsigned char* out = boxReduce(img, *width, *height, scale);
+        stbi_image_free(img);
+        *width = reduced(*width, scale);
+        *height = reduced(*height, scale);
+        return out;
+    }
+
+    static int reduced(int size, int scale) { return (size + scale - 1) / scale; }
+
+    // true se JPEGs reduzem na DCT; false = sempre stbi_load + boxReduce.
+    static constexpr bool kScaledJpeg = EDGE_STB_SCALED_JPEG && StbJpegLayout<stbi__jpeg>::value;
+
+private:
+    // Decodificador em uso nesta thread: o kernel de IDCT do stb nao recebe o componente, entao
+    // blocos fora do plano de luma sao reconhecidos pelo endereco e ignorados.
+    template <typename J>
+    static const J*& current() {
+        static thread_local const J* jpeg = nullptr;
+        return jpeg;
+    }
+
+    template <typename J>
+    static bool isLuma(const stbi_uc* out) {
+        const auto& luma = current<J>()->img_comp[0];
+        return out >= luma.data && out < luma.data + (size_t)luma.w2 * luma.h2;
+    }
+
+    static stbi_uc clampPixel(int p) { return (stbi_uc)(p < 0 ? 0 : p > 255 ? 255 : p); }
+
+    // IDCT de 4 pontos sobre os 4 primeiros coeficientes de uma linha (ou coluna) de 8, em borboleta
+    // como a IDCT de 8 do stb: out[x] = soma c(u)/2 * cos((2x+1) u pi / 8) * in[u], c(0) = 1/sqrt(2).
+    // Constantes em Q12; resultado em Q12 sobre a escala da entrada.
+    static inline void idct4(int i0, int i1, int i2, int i3, int& o0, int& o1, int& o2, int& o3) {
+        const int k = 1448;                // 0.5 / sqrt(2)
+        const int c1 = 1892, c3 = 784;     // 0.5 * cos(pi/8), 0.5 * cos(3pi/8)
+        int e0 = (i0 + i2) * k;
+        int e1 = (i0 - i2) * k;
+        int d0 = i1 * c1 + i3 * c3;
+        int d1 = i1 * c3 - i3 * c1;
+        o0 = e0 + d0;
+        o1 = e1 + d1;
+        o2 = e1 - d1;
+        o3 = e0 - d0;
+    }
+
+    // Substitui a IDCT 8x8 do stb: escreve K x K pixels no canto do bloco (o resto fica sem uso).
+    // Com os coeficientes da DCT de 8 pontos, a IDCT de K pontos sobre os K x K de baixa frequencia
+    // aproxima a media de cada sub-bloco (8/K) x (8/K). K = 2 e K = 1 saem em inteiro (somas / 8);
+    // K = 4 passa pelas linhas em Q3 (Q12 >> 9) e pelas colunas em int32, sem estouro para short.
+    template <int K, typename J>
+    static void idctReduced(stbi_uc* out, int stride, short data[64]) {
+        if (!isLuma<J>(out)) return;
+        if constexpr (K == 1) {
+            out[0] = clampPixel(((data[0] + 4) >> 3) + 128);
+        } else if constexpr (K == 2) {
+            int a = data[0] + data[8], b = data[0] - data[8];
+            int c = data[1] + data[9], d = data[1] - data[9];
+            out[0] = clampPixel(((a + c + 4) >> 3) + 128);
+            out[1] = clampPixel(((a - c + 4) >> 3) + 128);
+            out[stride] = clampPixel(((b + d + 4) >> 3) + 128);
+            out[stride + 1] = clampPixel(((b - d + 4) >> 3) + 128);
+        } else {
+            int rows[4][4];   // IDCT horizontal das 4 primeiras linhas de frequencia, em Q3
+            for (int v = 0; v < 4; v++) {
+                const short* in = data + v * 8;
+                int* r = rows[v];
+                idct4(in[0], in[1], in[2], in[3], r[0], r[1], r[2], r[3]);
+                for (int x = 0; x < 4; x++) r[x] = (r[x] + 256) >> 9;
+            }
+            for (int x = 0; x < 4; x++) {
+                int p[4];
+                idct4(rows[0][x], rows[1][x], rows[2][x], rows[3][x], p[0], p[1], p[2], p[3]);
+                for (int y = 0; y < 4; y++) out[y * stride + x] = clampPixel(((p[y] + 16384) >> 15) + 128);
+            }
+        }
+    }
+
+    // nullptr se o arquivo nao e JPEG com luma na resolucao cheia (quem chama cai no caminho inteiro).
+    // Template so para o corpo nao ser compilado quando a estrutura do stb nao confere.
+    template <typename J>
+    static unsigned char* loadJpegLuma(const char* path, int scale, int* width, int* height) {
+        if constexpr (!(EDGE_STB_SCALED_JPEG && StbJpegLayout<J>::value)) {
+            (void)path, (void)scale, (void)width, (void)height;
+            return nullptr;
+        } else {
+            FILE* f = std::fopen(path, "rb");
+            if (!f) return nullptr;
+            stbi__context s;
+            stbi__start_file(&s, f);
+            unsigned char* out = nullptr;
+            if (stbi__jpeg_test(&s)) {
+                J* j = (J*)stbi__malloc(sizeof(J));
+                if (j) {
+                    memset(j, 0, sizeof(J));
+                    j->s = &s;
+                    j->s->img_n = 0;
+                    stbi__setup_jpeg(j);
+                    j->idct_block_kernel = scale == 2 ? idctReduced<4, J> : scale == 4 ? idctReduced<2, J> : idctReduced<1, J>;
+                    current<J>() = j;
+                    if (stbi__decode_jpeg_image(j)) out = gatherLuma(j, 8 / scale, width, height);
+                    current<J>() = nullptr;
+                    stbi__cleanup_jpeg(j);
+                    STBI_FREE(j);
+                }
+            }
+            std::fclose(f);
+            return out;
+        }
+    }
+
+    // Junta os K x K pixels do canto de cada bloco num frame continuo.
+    template <typename J>
+    static unsigned char* gatherLuma(const J* j, int k, int* width, int* height) {
+        const auto& luma = j->img_comp[0];
+        bool isRgb = j->s->img_n == 3 && (j->rgb == 3 || (j->app14_color_transform == 0 && !j->jfif));
+        if (isRgb || j->s->img_n == 4 || luma.h != j->img_h_max || luma.v != j->img_v_max) return nullptr;
+
+        int w = reduced(j->s->img_x, 8 / k);
+        int h = reduced(j->s->img_y, 8 / k);
+        unsigned char* out = (unsigned char*)stbi__malloc((size_t)w * h);
+        if (!out) return nullptr;
+        for (int y = 0; y < h; y++) {
+            const stbi_uc* row = luma.data + (size_t)luma.w2 * ((y / k) * 8 + y % k);
+            unsigned char* dst = out + (size_t)y * w;
+            for (int x = 0; x < w; x += k, row += 8) {
+                for (int i = 0; i < k && x + i < w; i++) dst[x + i] = row[i];
+            }
+        }
+        *width = w;
+        *height = h;
+        return out;
+    }
+
+    // Media de blocos scale x scale (blocos da borda com os pixels que existem).
+    static unsigned char* boxReduce(const unsigned char* img, int width, int height, int scale) {
+        int w = reduced(width, scale);
+        int h = reduced(height, scale);
+        unsigned char* out = (unsigned char*)stbi__malloc((size_t)w * h);
+        if (!out) return nullptr;
+        for (int by = 0; by < h; by++) {
+            int y0 = by * scale, y1 = y0 + scale < height ? y0 + scale : height;
+            for (int bx = 0; bx < w; bx++) {
+                int x0 = bx * scale, x1 = x0 + scale < width ? x0 + scale : width;
+                int sum = 0;
+                for (int y = y0; y < y1; y++) {
+                    for (int x = x0; x < x1; x++) sum += img[(size_t)y * width + x];
+                }
+                int count = (y1 - y0) * (x1 - x0);
+                out[(size_t)by * w + bx] = (unsigned char)((sum + count / 2) / count);
+            }
+        }
+        return out;
+    }
+};
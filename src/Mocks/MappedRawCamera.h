@@ -0,0 +1,233 @@
+#pragma once
+#include "../HAL/ICamera.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Gravacao de luma crua para replay sem decodificacao, em um de dois formatos:
+// - pilha de PGM: frames P5 (maxval 255) concatenados num arquivo so, cada um com o seu cabecalho;
+// - Y4M: "YUV4MPEG2 W<w> H<h> F<n>:<d> C<cor>" e frames "FRAME\n" + planos. Com C mono o frame e so
+//   a luma; com C420* os planos de croma sao pulados.
+
+// Camera sobre um mmap da gravacao: capture() devolve um lease emprestado que aponta direto para o
+// mapeamento (sem copia, sem decodificacao, fora do limite de frames em voo). O arquivo e indexado
+// uma vez no init(); o kernel le a frente (MADV_SEQUENTIAL) e cada captura pede os proximos
+// frames com MADV_WILLNEED, entao o custo por frame e o page fault de paginas ja em cache.
+// So POSIX (mmap); o mapeamento precisa viver mais que os leases, ate o fim da camera.
+class MappedRawCamera : public ICamera {
+public:
+    explicit MappedRawCamera(const std::string& path, bool loop = false, int readAhead = 4)
+        : path(path), loop(loop), readAhead(readAhead) {}
+
+    ~MappedRawCamera() override { unmap(); }
+
+    bool init() override {
+        unmap();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "[RAW_CAM] Erro: '" << path << "' nao encontrado.\n";
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            size = (size_t)st.st_size;
+            void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            base = p == MAP_FAILED ? nullptr : (const uint8_t*)p;
+        }
+        ::close(fd);
+        if (!base) {
+            std::cerr << "[RAW_CAM] Erro: falha no mmap de '" << path << "'.\n";
+            size = 0;
+            return false;
+        }
+        madvise((void*)base, size, MADV_SEQUENTIAL);
+
+        bool indexed = size >= 10 && std::memcmp(base, "YUV4MPEG2 ", 10) == 0 ? indexY4m() : indexPgmStack();
+        if (!indexed || frames.empty()) {
+            std::cerr << "[RAW_CAM] Erro: '" << path << "' nao e pilha de PGM nem Y4M valido.\n";
+            unmap();
+            return false;
+        }
+        next = 0;
+        std::cout << "[RAW_CAM] " << frames.size() << " frames mapeados de '" << path << "'.\n";
+        return true;
+    }
+
+    // Proximo frame, sem copia; lease invalido no fim da gravacao (sem loop).
+    FrameLease capture() override {
+        if (frames.empty()) return FrameLease();
+        if (next >= frames.size()) {
+            if (!loop) return FrameLease();
+            next = 0;
+        }
+        prefetch(next + 1);
+        return FrameLease::borrow(frameView(next++));
+    }
+
+    // Acesso aleatorio (ex.: pular para um trecho da gravacao).
+    ImageView frameView(size_t index) const {
+        const Frame& f = frames[index];
+        return ImageView(base + f.offset, f.width, f.height, f.width);
+    }
+    size_t frameCount() const { return frames.size(); }
+    void seek(size_t index) { next = index; }
+
+private:
+    struct Frame {
+        size_t offset;
+        int width, height;
+    };
+
+    // Proximos readAhead frames: um madvise so, alinhado a pagina.
+    void prefetch(size_t first) {
+        if (readAhead <= 0 || first >= frames.size()) return;
+        size_t last = std::min(frames.size(), first + (size_t)readAhead) - 1;
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        size_t begin = frames[first].offset / page * page;
+        size_t end = frames[last].offset + (size_t)frames[last].width * frames[last].height;
+        madvise((void*)(base + begin), end - begin, MADV_WILLNEED);
+    }
+
+    // Le um inteiro decimal a partir de pos (pulando espacos e comentarios #); -1 se nao ha.
+    long readNumber(size_t& pos) const {
+        for (;;) {
+            while (pos < size && std::isspace(base[pos])) pos++;
+            if (pos < size && base[pos] == '#') {
+                while (pos < size && base[pos] != '\n') pos++;
+                continue;
+            }
+            break;
+        }
+        if (pos >= size || !std::isdigit(base[pos])) return -1;
+        long value = 0;
+        while (pos < size && std::isdigit(base[pos]) && value < (1L << 30)) value = value * 10 + (base[pos++] - '0');
+        return value;
+    }
+
+    bool indexPgmStack() {
+        size_t pos = 0;
+        while (pos + 2 <= size && base[pos] == 'P' && base[pos + 1] == '5') {
+            pos += 2;
+            long w = readNumber(pos), h = readNumber(pos), maxval = readNumber(pos);
+            if (w <= 0 || h <= 0 || maxval != 255 || pos >= size) return false;
+            pos++;   // um espaco separa o cabecalho dos pixels
+            if ((size_t)(w * h) > size - pos) return false;
+            frames.push_back({ pos, (int)w, (int)h });
+            pos += (size_t)(w * h);
+            while (pos < size && std::isspace(base[pos])) pos++;
+        }
+        return pos >= size;
+    }
+
+    bool indexY4m() {
+        const uint8_t* end = (const uint8_t*)std::memchr(base, '\n', size);
+        if (!end) return false;
+        std::string header((const char*)base, end - base);
+        int w = 0, h = 0;
+        std::string color = "420jpeg";   // padrao do formato
+        size_t start = 0;
+        while (start < header.size()) {
+            size_t stop = header.find(' ', start);
+            if (stop == std::string::npos) stop = header.size();
+            std::string token = header.substr(start, stop - start);
+            if (token.size() > 1 && token[0] == 'W') w = std::atoi(token.c_str() + 1);
+            if (token.size() > 1 && token[0] == 'H') h = std::atoi(token.c_str() + 1);
+            if (token.size() > 1 && token[0] == 'C') color = token.substr(1);
+            start = stop + 1;
+        }
+        if (w <= 0 || h <= 0) return false;
+        size_t luma = (size_t)w * h;
+        size_t chroma = 0;
+        if (color.compare(0, 3, "420") == 0) chroma = 2 * (size_t)((w + 1) / 2) * ((h + 1) / 2);
+        else if (color != "mono") return false;
+
+        size_t pos = end - base + 1;
+        while (pos + 5 <= size && std::memcmp(base + pos, "FRAME", 5) == 0) {
+            const uint8_t* eol = (const uint8_t*)std::memchr(base + pos, '\n', size - pos);
+            if (!eol) return false;
+            pos = eol - base + 1;
+            if (luma + chroma > size - pos) return false;
+            frames.push_back({ pos, w, h });
+            pos += luma + chroma;
+        }
+        return pos >= size;
+    }
+
+    void unmap() {
+        if (base) munmap((void*)base, size);
+        base = nullptr;
+        size = 0;
+        frames.clear();
+    }
+
+    std::string path;
+    bool loop;
+    int readAhead;
+    const uint8_t* base = nullptr;
+    size_t size = 0;
+    std::vector<Frame> frames;
+    size_t next = 0;
+};
+
+// Escreve uma gravacao crua frame a frame: ".y4m" vira Y4M mono (todos os frames do tamanho do
+// primeiro), qualquer outra extensao vira pilha de PGM (tamanhos livres).
+class RawRecordingWriter {
+public:
+    explicit RawRecordingWriter(const std::string& path, int fps = 30)
+        : y4m(path.size() >= 4 && path.compare(path.size() - 4, 4, ".y4m") == 0), fps(fps) {
+        file = std::fopen(path.c_str(), "wb");
+    }
+    ~RawRecordingWriter() { close(); }
+
+    RawRecordingWriter(const RawRecordingWriter&) = delete;
+    RawRecordingWriter& operator=(const RawRecordingWriter&) = delete;
+
+    bool isOpen() const { return file != nullptr; }
+
+    // false se falhou a escrita ou se o tamanho nao bate com o do Y4M.
+    bool append(const ImageView& frame) {
+        if (!file || !frame.data) return false;
+        if (y4m) {
+            if (written == 0) {
+                width = frame.width;
+                height = frame.height;
+                std::fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 Cmono\n", width, height, fps);
+            } else if (frame.width != width || frame.height != height) {
+                return false;
+            }
+            std::fputs("FRAME\n", file);
+        } else {
+            std::fprintf(file, "P5\n%d %d\n255\n", frame.width, frame.height);
+        }
+        for (int y = 0; y < frame.height; y++) {
+            if (std::fwrite(frame.row(y), 1, frame.width, file) != (size_t)frame.width) return false;
+        }
+        written++;
+        return true;
+    }
+
+    int frames() const { return written; }
+
+    bool close() {
+        bool ok = file && std::fclose(file) == 0;
+        file = nullptr;
+        return ok;
+    }
+
+private:
+    FILE* file = nullptr;
+    bool y4m;
+    int fps;
+    int width = 0;
+    int height = 0;
+    int written = 0;
+};
@@ -1,5 +1,6 @@
 #pragma once
 #include "../HAL/ICamera.h"
+#include <algorithm>
 #include <iostream>
 
 class MockCamera : public ICamera {
@@ -9,14 +10,16 @@ public:
         return true;
     }
 
-    ImageFrame capture() override {
+    FrameLease capture() override {
         std::cout << "[MOCK] Capturando frame 320x240...\n";
         
-        ImageFrame frame;
-        frame.width = 320;
-        frame.height = 240;
-        frame.data.resize(320 * 240, 128); // Fundo Cinza (Sem bordas)
-        frame.valid = true;
+        FrameLease frame = framePool.acquire(320 * 240);
+        if (!frame.setFrame(320, 240)) {
+            std::cout << "[MOCK] Sem buffer livre no pool.\n";
+            return FrameLease();
+        }
+        uint8_t* data = frame.data();
+        std::fill(data, data + 320 * 240, 128); // Fundo Cinza (Sem bordas)
 
         // --- INJEÇÃO DE FALHA (Fissura Simulada) ---
         // Desenha uma linha preta vertical no meio da imagem
@@ -24,17 +27,11 @@ public:
         int meio = 160; 
         for(int y = 0; y < 240; y++) {
             // Desenha uma linha de 3 pixels de espessura
-            frame.data[y * 320 + meio] = 0;     // Preto
-            frame.data[y * 320 + meio + 1] = 0; 
-            frame.data[y * 320 + meio + 2] = 0; 
+            data[y * 320 + meio] = 0;     // Preto
+            data[y * 320 + meio + 1] = 0; 
+            data[y * 320 + meio + 2] = 0; 
         }
 
         return frame;
     }
-
-    void returnFrame(ImageFrame& frame) override {
-        // Simula a liberação do buffer da câmera
-        frame.data.clear();
-        frame.valid = false;
-    }
 };
\ No newline at end of file
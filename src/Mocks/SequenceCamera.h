@@ -0,0 +1,258 @@
+#pragma once
+#include "../HAL/ICamera.h"
+#include "ImageDecoder.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct SequenceOptions {
+    int prefetch = 8;    // frames decodificados a frente do consumidor (tamanho da fila)
+    int threads = 2;     // decodificadores em background
+    bool loop = false;   // volta ao primeiro frame no fim da sequencia
+    int fps = 0;         // 0 = o mais rapido possivel; > 0 = capture() entrega no maximo fps frames/s
+    int width = 0;       // resolucao pedida (ver FileCamera::setRequestedResolution); 0 = cheia
+    int height = 0;
+
+    // Relogio e espera do ritmo de fps (padrao: steady_clock e sleep_until); os testes trocam por
+    // um relogio falso para verificar o ritmo sem depender do tempo real.
+    std::function<std::chrono::steady_clock::time_point()> now;
+    std::function<void(std::chrono::steady_clock::time_point)> sleepUntil;
+};
+
+// Camera de replay de uma gravacao: todos os arquivos de imagem de um diretorio (em ordem de nome)
+// ou os caminhos de um manifesto (arquivo texto, um caminho por linha, relativo ao manifesto,
+// linhas vazias e com # ignoradas). Um pool de threads decodifica ate `prefetch` frames a frente,
+// fora de ordem, em buffers do pool da camera; capture() entrega em ordem e so espera quando a
+// decodificacao esta atrasada. Frames que falham na decodificacao sao pulados com log.
+// O pool e a reducao de decodificacao sao escolhidos pelo primeiro frame: frames maiores que
+// ele tambem sao pulados. O pool cobre a janela de prefetch mais 2 frames com o consumidor; se o
+// consumidor segura mais, capture() devolve lease invalido em vez de esperar um frame que nunca
+// ganharia buffer (e volta a entregar quando algum frame e solto).
+class SequenceCamera : public ICamera {
+public:
+    explicit SequenceCamera(const std::string& source, const SequenceOptions& options = SequenceOptions())
+        : source(source), options(options) {
+        this->options.prefetch = std::max(1, options.prefetch);
+        this->options.threads = std::max(1, options.threads);
+        if (!this->options.now) this->options.now = [] { return std::chrono::steady_clock::now(); };
+        if (!this->options.sleepUntil) {
+            this->options.sleepUntil = [](std::chrono::steady_clock::time_point due) { std::this_thread::sleep_until(due); };
+        }
+        // Buffer devolvido: acorda o decodificador que espera um. O mutex garante que o aviso nao
+        // se perde entre a tentativa dele e a espera.
+        framePool.setReleaseListener([this] {
+            { std::lock_guard<std::mutex> lock(mutex); }
+            freed.notify_all();
+        });
+    }
+
+    ~SequenceCamera() override { stop(); }
+
+    bool init() override {
+        stop();
+        files.clear();
+        if (!listFiles()) return false;
+
+        // O primeiro frame define o tamanho dos buffers: fila cheia + 2 frames com o consumidor.
+        int width, height, channels;
+        if (!stbi_info(files[0].c_str(), &width, &height, &channels)) {
+            std::cerr << "[SEQ_CAM] Nao foi possivel ler '" << files[0] << "'.\n";
+            return false;
+        }
+        scale = ImageDecoder::scaleFor(files[0].c_str(), options.width, options.height);
+        if (!framePool.reserve(options.prefetch + 2,
+                               (size_t)ImageDecoder::reduced(width, scale) * ImageDecoder::reduced(height, scale))) {
+            std::cerr << "[SEQ_CAM] Erro: frames de antes do init() ainda emprestados.\n";
+            return false;
+        }
+
+        slots.clear();
+        slots.resize(options.prefetch);
+        done.assign(options.prefetch, kPending);
+        nextIndex = 0;
+        consumed = 0;
+        failures = 0;
+        stopping = false;
+        for (int i = 0; i < options.threads; i++) workers.emplace_back([this] { decodeLoop(); });
+        std::cout << "[SEQ_CAM] " << files.size() << " frames em '" << source << "', " << options.threads
+                  << " decodificadores, " << options.prefetch << " a frente.\n";
+        return true;
+    }
+
+    // Proximo frame em ordem; lease invalido no fim da sequencia (sem loop).
+    FrameLease capture() override {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            if (workers.empty() || (!options.loop && consumed >= files.size())) return FrameLease();
+            if (failures >= files.size()) return FrameLease();   // nenhum arquivo decodifica
+
+            size_t slot = consumed % slots.size();
+            // Slot sem buffer e pool vazio: so o consumidor pode devolver um, entao nao espera. Com
+            // buffer livre o decodificador ja foi acordado e o slot sai do estado sem buffer.
+            ready.wait(lock, [&] {
+                return done[slot] == kDone || (done[slot] == kStarved && framePool.available() == 0);
+            });
+            if (done[slot] == kStarved) {
+                std::cerr << "[SEQ_CAM] Sem buffer livre: o consumidor segura frames demais.\n";
+                return FrameLease();
+            }
+            FrameLease frame = std::move(slots[slot]);
+            done[slot] = kPending;
+            consumed++;
+            work.notify_all();
+            if (!frame.valid()) {
+                failures++;
+                continue;
+            }
+            failures = 0;
+
+            lock.unlock();
+            pace();
+            return frame;
+        }
+    }
+
+    size_t frameCount() const { return files.size(); }
+
+private:
+    bool listFiles() {
+        namespace fs = std::filesystem;
+        std::error_code error;
+        if (fs::is_directory(source, error)) {
+            for (const auto& entry : fs::directory_iterator(source, error)) {
+                if (entry.is_regular_file() && isImage(entry.path())) files.push_back(entry.path().string());
+            }
+            std::sort(files.begin(), files.end());
+        } else {
+            std::ifstream manifest(source);
+            if (!manifest) {
+                std::cerr << "[SEQ_CAM] Erro: '" << source << "' nao e diretorio nem manifesto.\n";
+                return false;
+            }
+            fs::path base = fs::path(source).parent_path();
+            std::string line;
+            while (std::getline(manifest, line)) {
+                line.erase(line.find_last_not_of(" \t\r") + 1);
+                if (line.empty() || line[0] == '#') continue;
+                fs::path path(line);
+                files.push_back((path.is_absolute() ? path : base / path).string());
+            }
+        }
+        if (files.empty()) std::cerr << "[SEQ_CAM] Erro: nenhum frame em '" << source << "'.\n";
+        return !files.empty();
+    }
+
+    static bool isImage(const std::filesystem::path& path) {
+        std::string ext = path.extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+        return ext == ".jpg" || ext == ".jpeg" || ext == ".png" || ext == ".bmp" || ext == ".pgm" || ext == ".ppm";
+    }
+
+    // Cada decodificador pega o proximo indice da sequencia, desde que caiba na janela de prefetch
+    // a frente do consumidor; o resultado vai para o slot do indice (anel de prefetch posicoes).
+    void decodeLoop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            work.wait(lock, [&] {
+                return stopping || ((options.loop || nextIndex < files.size()) && nextIndex < consumed + slots.size());
+            });
+            if (stopping) return;
+            size_t index = nextIndex++;
+            lock.unlock();
+
+            FrameLease frame = decode(files[index % files.size()], index % slots.size());
+
+            lock.lock();
+            slots[index % slots.size()] = std::move(frame);
+            done[index % slots.size()] = kDone;
+            ready.notify_all();
+        }
+    }
+
+    FrameLease decode(const std::string& path, size_t slot) {
+        int width, height;
+        unsigned char* img = ImageDecoder::loadGray(path.c_str(), scale, &width, &height);
+        if (!img) {
+            std::cerr << "[SEQ_CAM] Falha ao decodificar '" << path << "'.\n";
+            return FrameLease();
+        }
+
+        FrameLease frame = acquireBuffer(slot);
+        if (frame.setFrame(width, height)) {
+            std::copy(img, img + (size_t)width * height, frame.data());
+        } else if (frame.data()) {
+            std::cerr << "[SEQ_CAM] '" << path << "' maior que o primeiro frame, pulado.\n";
+            frame.reset();
+        }
+        stbi_image_free(img);
+        return frame;
+    }
+
+    // A janela de prefetch cabe no pool; so falta buffer se o consumidor segura frames demais. Nesse
+    // caso o slot fica marcado (capture() nao espera por ele) ate um frame ser solto ou stop().
+    FrameLease acquireBuffer(size_t slot) {
+        std::unique_lock<std::mutex> lock(mutex);
+        FrameLease frame = framePool.acquire();
+        while (!frame.data() && !stopping) {
+            done[slot] = kStarved;
+            ready.notify_all();
+            freed.wait(lock);
+            done[slot] = kPending;
+            frame = framePool.acquire();
+        }
+        return frame;
+    }
+
+    // Taxa fixa: o frame k sai no instante inicio + k / fps (sem acumular atraso de frames lentos).
+    void pace() {
+        if (options.fps <= 0) return;
+        auto now = options.now();
+        if (paced == 0) start = now;
+        auto due = start + std::chrono::microseconds(1000000LL * paced / options.fps);
+        paced++;
+        if (due > now) options.sleepUntil(due);
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        work.notify_all();
+        freed.notify_all();
+        for (auto& t : workers) t.join();
+        workers.clear();
+        slots.clear();
+        paced = 0;
+    }
+
+    std::string source;
+    SequenceOptions options;
+    std::vector<std::string> files;
+    int scale = 1;   // reducao de decodificacao, escolhida pelo primeiro frame
+
+    std::mutex mutex;
+    std::condition_variable work;    // decodificadores: ha indice livre na janela
+    std::condition_variable ready;   // consumidor: o proximo frame chegou (ou ficou sem buffer)
+    std::condition_variable freed;   // decodificadores: um buffer voltou ao pool
+    std::vector<std::thread> workers;
+    std::vector<FrameLease> slots;
+    enum : uint8_t { kPending, kDone, kStarved };
+    std::vector<uint8_t> done;       // estado de cada slot do anel
+    size_t nextIndex = 0;
+    size_t consumed = 0;
+    size_t failures = 0;
+    bool stopping = false;
+
+    long long paced = 0;
+    std::chrono::steady_clock::time_point start;
+};
@@ -6,12 +6,19 @@
 #include <fstream>
 #include <string>
 #include <filesystem>
+#include <algorithm>
+#include <cstdlib>
 
+#include "HAL/AsyncCapture.h"
 #include "HAL/ICamera.h"
 #include "Core/EdgeProcessor.h"
+#include "Core/AsciiRenderer.h"
+#include "Core/ChangeDetector.h"
 #include "Core/PacketBuilder.h"
 #include "Core/SerialProtocol.h"
 #include "Mocks/FileCamera.h"
+#include "Mocks/MappedRawCamera.h"
+#include "Mocks/SequenceCamera.h"
 
 namespace fs = std::filesystem; 
 
@@ -60,14 +67,131 @@ void salvarRelatorioVisual(int ciclo, const std::string& mapaVisual) {
     }
 }
 
-int main() {
+// Laco de replay na taxa maxima: mede captura + deteccao de mudanca + analise + pacote, sem sleep
+// nem log por ciclo. A captura roda em paralelo com a analise (AsyncCapture): o ciclo custa o maior
+// dos dois. frames <= 0: ate a camera acabar (sequencia sem loop).
+int medirReplay(ICamera& camera, EdgeProcessor& processor, int frames) {
+    AsyncCapture capture(camera);
+    AnalysisResult result;
+    ChangeDetector changeDetector;
+    SensorData sensors = { {0.1f, 0.0f, 9.8f, 0.0f, 0.0f, 0.0f}, 450.0f, 300.0f };
+    int capturados = 0;
+    int analisados = 0;
+    int ciclosSemMudanca = 0;
+    size_t bytes = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    capture.start();
+    while (frames <= 0 || capturados < frames) {
+        FrameLease frame = capture.acquire();
+        if (!frame.valid()) {
+            if (frames > 0 || capturados == 0) return -1;
+            break;
+        }
+        capturados++;
+        std::string json;
+        if (changeDetector.changed(frame)) {
+            processor.analyze(frame, result);
+            analisados++;
+            ciclosSemMudanca = 0;
+            json = PacketBuilder::build("SIM-CHIP-001", sensors, result);
+        } else {
+            ciclosSemMudanca++;
+            json = PacketBuilder::heartbeat("SIM-CHIP-001", result, ciclosSemMudanca);
+        }
+        bytes += SerialProtocol::pack(json).size();
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "[REPLAY] " << capturados << " frames (" << analisados << " analisados) em " << std::fixed
+              << std::setprecision(1) << ms << " ms: " << capturados * 1000.0 / ms << " frames/s, "
+              << ms / capturados << " ms/frame, " << bytes / capturados << " bytes/frame, "
+              << capture.waitedMicros() / 1000.0 / capturados << " ms/frame esperando a captura\n";
+    return 0;
+}
+
+// Replay da foto: a camera serve a imagem decodificada uma vez, com deslocamento, ruido e ganho
+// sorteados por frame (para o detector de mudanca e o modo incremental nao pularem trabalho).
+int executarReplay(FileCamera& camera, EdgeProcessor& processor, int frames) {
+    FramePerturbation perturbation;
+    perturbation.maxShift = 4;
+    perturbation.noise = 3;
+    perturbation.gainPercent = 5;
+    camera.setCached(true, perturbation);
+
+    camera.capture();   // decodificacao fora da medicao
+    return medirReplay(camera, processor, frames);
+}
+
+// Replay de uma gravacao (diretorio ou manifesto), decodificada a frente em background.
+int executarSequencia(const std::string& origem, EdgeProcessor& processor, int fps) {
+    SequenceOptions options;
+    options.threads = std::max(1u, std::thread::hardware_concurrency() / 2);
+    options.prefetch = 2 * options.threads + 2;
+    options.fps = fps;
+    SequenceCamera camera(origem, options);
+    if (!camera.init()) return -1;
+    return medirReplay(camera, processor, 0);
+}
+
+// Replay de uma gravacao crua (pilha de PGM ou Y4M) por mmap: sem decodificacao.
+int executarRaw(const std::string& arquivo, EdgeProcessor& processor) {
+    MappedRawCamera camera(arquivo);
+    if (!camera.init()) return -1;
+    return medirReplay(camera, processor, 0);
+}
+
+// Converte um diretorio (ou manifesto) de JPEGs numa gravacao crua, decodificando em paralelo;
+// largura x altura opcionais escolhem a reducao de decodificacao (ver FileCamera).
+int converterGravacao(const std::string& origem, const std::string& destino, int largura, int altura) {
+    SequenceOptions options;
+    options.threads = std::max(1u, std::thread::hardware_concurrency());
+    options.prefetch = 2 * options.threads + 2;
+    options.width = largura;
+    options.height = altura;
+    SequenceCamera camera(origem, options);
+    RawRecordingWriter writer(destino);
+    if (!camera.init() || !writer.isOpen()) return -1;
+
+    int pulados = 0;
+    for (FrameLease frame = camera.capture(); frame.valid(); frame = camera.capture()) {
+        if (!writer.append(frame)) pulados++;
+    }
+    if (!writer.close()) return -1;
+    std::cout << "[CONVERSAO] " << writer.frames() << " frames em '" << destino << "'";
+    if (pulados) std::cout << " (" << pulados << " com tamanho diferente, pulados)";
+    std::cout << "\n";
+    return 0;
+}
+
+int main(int argc, char** argv) {
     std::cout << "==========================================\n";
     std::cout << "   DIGITAL TWIN: VALIDACAO COM FOTO REAL\n";
     std::cout << "==========================================\n";
 
-    FileCamera camera("../teste.jpg"); 
     EdgeProcessor processor;
-    
+    processor.setSegmentation(true);   // o backend recebe os trechos de fissura, nao so a densidade
+    processor.setOrientationOutput(true);
+    processor.setSharpnessGate(true);   // so mede: o limiar de descarte depende da cena (calibrateSharpnessGate)
+    AnalysisResult result;
+
+    // SimulateSystem --sequence DIR|MANIFESTO [FPS]: gravacao inteira, na taxa maxima ou em FPS fixo.
+    if (argc >= 3 && std::string(argv[1]) == "--sequence") {
+        return executarSequencia(argv[2], processor, argc >= 4 ? std::atoi(argv[3]) : 0);
+    }
+
+    // SimulateSystem --raw ARQUIVO: gravacao crua (.pgm em pilha ou .y4m) mapeada, na taxa maxima.
+    if (argc >= 3 && std::string(argv[1]) == "--raw") {
+        return executarRaw(argv[2], processor);
+    }
+
+    // SimulateSystem --convert DIR|MANIFESTO SAIDA(.y4m|.pgm) [LARGURA ALTURA]
+    if (argc >= 4 && std::string(argv[1]) == "--convert") {
+        return converterGravacao(argv[2], argv[3], argc >= 6 ? std::atoi(argv[4]) : 0,
+                                 argc >= 6 ? std::atoi(argv[5]) : 0);
+    }
+
+    FileCamera camera("../teste.jpg");
     if (!camera.init()) {
         std::cerr << "[ERRO CRITICO] Imagem '../teste.jpg' nao encontrada.\n";
         std::cerr << "Certifique-se de que a imagem esta na raiz do projeto (fora da pasta src ou build).\n";
@@ -76,37 +200,56 @@ int main() {
     
     std::cout << "[ESP32] Hardware inicializado.\n\n";
 
+    // SimulateSystem --replay N: N frames na taxa maxima do pipeline.
+    if (argc >= 3 && std::string(argv[1]) == "--replay") {
+        return executarReplay(camera, processor, std::max(1, std::atoi(argv[2])));
+    }
+
+    // O proximo frame ja e capturado enquanto o atual e analisado e enviado. Sem detector de
+    // mudanca: cada ciclo analisa e grava o seu relatorio (a foto e a mesma nos tres ciclos; o
+    // detector so entra nos modos de replay, que tem cenas que mudam).
+    AsyncCapture capture(camera);
+    capture.start();
+
     for (int i = 1; i <= 3; i++) {
         std::cout << ">>> CICLO " << i << " <<<\n";
 
-        ImageFrame frame = camera.capture();
-        if (!frame.valid) break;
+        FrameLease frame = capture.acquire();
+        if (!frame.valid()) break;
 
         auto start = std::chrono::high_resolution_clock::now();
-        AnalysisResult result = processor.analyze(frame);
+        processor.analyze(frame, result);
         auto end = std::chrono::high_resolution_clock::now();
         
         result.process_time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
 
         std::cout << "    [ESP32] Processamento Local:\n";
-        std::cout << "        - Dimensoes: " << frame.width << "x" << frame.height << "\n";
-        std::cout << "        - Bordas: " << std::fixed << std::setprecision(2) << (result.edge_density * 100.0f) << "%\n";
+        std::cout << "        - Dimensoes: " << frame.width() << "x" << frame.height() << "\n";
+        std::cout << "        - Nitidez: " << result.sharpness << "\n";
+        if (result.reject_reason != RejectReason::None) {
+            std::cout << "        - Frame descartado (" << rejectReasonName(result.reject_reason) << ")\n";
+            continue;
+        }
+        std::cout << "        - Bordas: " << q16::format(result.edge_density_q16 * 100, 2) << "%\n";
+        std::cout << "        - Trechos de fissura: " << result.segments.size()
+                  << " (" << result.segments_dropped << " descartados como ruido)\n";
+        std::cout << "        - Direcao dominante: " << result.dominant_direction_deg << " graus\n";
         
-        salvarRelatorioVisual(i, result.ascii_map);
+        salvarRelatorioVisual(i, AsciiRenderer::render(result.edge_mask));
 
-        SensorData sensors = { {0.1f, 0.0f, 9.8f}, (float)(500 - i * 50), 300.0f };
+        SensorData sensors = { {0.1f, 0.0f, 9.8f, 0.0f, 0.0f, 0.0f}, (float)(500 - i * 50), 300.0f };
         std::string json = PacketBuilder::build("SIM-CHIP-001", sensors, result);
         std::vector<uint8_t> packet = SerialProtocol::pack(json);
 
         std::cout << "    [ESP32] Enviando " << packet.size() << " bytes...\n";
         simularServidorCloud(packet);
 
-        camera.returnFrame(frame);
-        
         std::cout << "------------------------------------------\n";
         std::this_thread::sleep_for(std::chrono::milliseconds(1000));
     }
 
+    QualityStats stats = processor.qualityStats();
+    std::cout << "[SISTEMA] Frames descartados pelo filtro de nitidez: " << stats.rejected << "/" << stats.frames << "\n";
     std::cout << "[SISTEMA] Simulacao concluida.\n";
     return 0;
 }
\ No newline at end of file
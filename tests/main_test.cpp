@@ -1,8 +1,88 @@
 #include <gtest/gtest.h>
 #include "EdgeProcessor.h"
+#include "AsciiRenderer.h"
+#include "Convolve3x3.h"
+#include "ChangeDetector.h"
+#include "CrackSegmenter.h"
+#include "FrameBufferPool.h"
+#include "AsyncCapture.h"
+#include "../src/Mocks/FileCamera.h"
+#include "../src/Mocks/MockCamera.h"
+#include "../src/Mocks/MappedRawCamera.h"
+#include "../src/Mocks/SequenceCamera.h"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <cstdio>
 #include "../src/Core/PacketBuilder.h"
 #include <iostream>
 #include "../src/Core/SerialProtocol.h"
+#include <random>
+#include <cmath>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <tuple>
+
+// Contador de alocacoes: o operator new global e substituido so neste executavel de testes.
+static std::atomic<bool> g_countAllocations{false};
+static std::atomic<long> g_allocations{0};
+
+static void* countedAlloc(std::size_t size, std::size_t alignment) {
+    if (g_countAllocations) g_allocations++;
+    if (size == 0) size = 1;
+    void* p = alignment > alignof(std::max_align_t)
+                  ? std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment)
+                  : std::malloc(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(std::size_t size) { return countedAlloc(size, 0); }
+void* operator new[](std::size_t size) { return countedAlloc(size, 0); }
+void* operator new(std::size_t size, std::align_val_t a) { return countedAlloc(size, (std::size_t)a); }
+void* operator new[](std::size_t size, std::align_val_t a) { return countedAlloc(size, (std::size_t)a); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+// Referencia ingenua: clamp por eixo em cada tap, blur no frame inteiro e Sobel no interior.
+static int referenceEdgeCount(const ImageFrame& frame, int threshold) {
+    int w = frame.width;
+    int h = frame.height;
+    auto px = [&](const std::vector<uint8_t>& img, int x, int y) {
+        x = std::min(std::max(x, 0), w - 1);
+        y = std::min(std::max(y, 0), h - 1);
+        return (int)img[y * w + x];
+    };
+
+    std::vector<uint8_t> blurred(w * h);
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            int sum = px(frame.data, x-1, y-1) + 2 * px(frame.data, x, y-1) + px(frame.data, x+1, y-1)
+                    + 2 * px(frame.data, x-1, y) + 4 * px(frame.data, x, y) + 2 * px(frame.data, x+1, y)
+                    + px(frame.data, x-1, y+1) + 2 * px(frame.data, x, y+1) + px(frame.data, x+1, y+1);
+            blurred[y * w + x] = sum / 16;
+        }
+    }
+
+    int count = 0;
+    for (int y = 1; y < h - 1; y++) {
+        for (int x = 1; x < w - 1; x++) {
+            int gx = px(blurred, x+1, y-1) + 2 * px(blurred, x+1, y) + px(blurred, x+1, y+1)
+                   - px(blurred, x-1, y-1) - 2 * px(blurred, x-1, y) - px(blurred, x-1, y+1);
+            int gy = px(blurred, x-1, y+1) + 2 * px(blurred, x, y+1) + px(blurred, x+1, y+1)
+                   - px(blurred, x-1, y-1) - 2 * px(blurred, x, y-1) - px(blurred, x+1, y-1);
+            if ((int)std::sqrt(gx*gx + gy*gy) > threshold) count++;
+        }
+    }
+    return count;
+}
 
 
 TEST(EdgeProcessing, DetectsLineCrack) {
@@ -18,10 +98,1052 @@ TEST(EdgeProcessing, DetectsLineCrack) {
     EdgeProcessor processor;
     AnalysisResult result = processor.analyze(frame);
 
-    std::cout << "[TESTE] Densidade Detectada: " << result.edge_density << std::endl;
+    std::cout << "[TESTE] Densidade Detectada: " << q16::format(result.edge_density_q16, 4) << std::endl;
     
-    EXPECT_GT(result.edge_density, 0.0); 
-    EXPECT_LT(result.edge_density, 0.1); 
+    EXPECT_GT(result.edge_density_q16, 0u);
+    EXPECT_LT(result.edge_density_q16, q16::One / 10);
+}
+
+TEST(EdgeProcessing, SimdKernelsMatchScalarReference) {
+    ImageFrame frame;
+    frame.width = 333;
+    frame.height = 97;
+    frame.data.resize(333 * 97);
+
+    std::mt19937 rng(42);
+    for (auto& p : frame.data) p = rng() & 0xFF;
+
+    for (MagnitudeMode mode : { MagnitudeMode::L2, MagnitudeMode::L1, MagnitudeMode::LInf }) {
+        EdgeProcessor reference;
+        reference.setKernels(KernelIsa::Scalar);
+        reference.setMagnitudeMode(mode);
+        AnalysisResult expected = reference.analyze(frame);
+
+        for (KernelIsa isa : { KernelIsa::SSE2, KernelIsa::AVX2 }) {
+            EdgeProcessor processor;
+            if (!processor.setKernels(isa)) continue;
+            processor.setMagnitudeMode(mode);
+            AnalysisResult result = processor.analyze(frame);
+
+            EXPECT_EQ(result.edge_density_q16, expected.edge_density_q16) << processor.activeKernels().name;
+            EXPECT_EQ(result.edge_mask, expected.edge_mask) << processor.activeKernels().name;
+        }
+    }
+}
+
+TEST(EdgeProcessing, MagnitudeModesBracketExactL2) {
+    ImageFrame frame;
+    frame.width = 120;
+    frame.height = 90;
+    frame.data.resize(120 * 90);
+
+    std::mt19937 rng(11);
+    for (auto& p : frame.data) p = (rng() % 4) ? 60 : 180;
+
+    EdgeProcessor processor;
+    processor.setGradientOutput(true);
+    AnalysisResult l2 = processor.analyze(frame);
+
+    processor.setGradientOutput(false);
+    processor.setMagnitudeMode(MagnitudeMode::L1);
+    AnalysisResult l1 = processor.analyze(frame);
+    processor.setMagnitudeMode(MagnitudeMode::LInf);
+    AnalysisResult linf = processor.analyze(frame);
+
+    EXPECT_TRUE(l1.gradient_magnitude.empty());
+    ASSERT_EQ(l2.gradient_magnitude.size(), frame.data.size());
+
+    for (int y = 0; y < frame.height; y++) {
+        for (int x = 0; x < frame.width; x++) {
+            bool edge = l2.edge_mask.get(x, y);
+
+            EXPECT_EQ(edge, l2.gradient_magnitude[y * frame.width + x] > 100);
+            if (edge) {
+                EXPECT_TRUE(l1.edge_mask.get(x, y));
+            }
+            if (linf.edge_mask.get(x, y)) {
+                EXPECT_TRUE(edge);
+            }
+        }
+    }
+    EXPECT_GE(l1.edge_density_q16, l2.edge_density_q16);
+    EXPECT_LE(linf.edge_density_q16, l2.edge_density_q16);
+}
+
+TEST(EdgeProcessing, ParallelBandsMatchSerial) {
+    std::mt19937 rng(7);
+    EdgeProcessor serial;
+
+    for (int h : { 3, 5, 61, 240 }) {
+        ImageFrame frame;
+        frame.width = 150;
+        frame.height = h;
+        frame.data.resize(150 * h);
+        for (auto& p : frame.data) p = (rng() % 5) ? 90 : 250;
+
+        AnalysisResult expected = serial.analyze(frame);
+
+        for (int threads : { 2, 3, 8 }) {
+            EdgeProcessor parallel;
+            parallel.setThreadCount(threads);
+            AnalysisResult result = parallel.analyze(frame);
+
+            EXPECT_EQ(result.edge_density_q16, expected.edge_density_q16) << "h=" << h << " threads=" << threads;
+            EXPECT_EQ(result.edge_mask, expected.edge_mask) << "h=" << h << " threads=" << threads;
+        }
+    }
+}
+
+TEST(EdgeProcessing, NonSquareFramesMatchClampedReference) {
+    std::mt19937 rng(3);
+    const int sizes[][2] = { { 320, 240 }, { 240, 320 }, { 1600, 1200 } };
+
+    for (const auto& size : sizes) {
+        ImageFrame frame;
+        frame.width = size[0];
+        frame.height = size[1];
+        frame.data.resize(size[0] * size[1]);
+        for (auto& p : frame.data) p = (rng() % 7) ? 200 : (rng() & 0xFF);
+
+        EdgeProcessor processor;
+        AnalysisResult result = processor.analyze(frame);
+        int expected = referenceEdgeCount(frame, 100);
+
+        EXPECT_EQ(result.edge_density_q16, q16::fromRatio(expected, size[0] * size[1])) << size[0] << "x" << size[1];
+
+        // Frame uniforme e claro: a borda replicada nao pode gerar um anel falso de bordas.
+        std::fill(frame.data.begin(), frame.data.end(), 200);
+        EXPECT_EQ(processor.analyze(frame).edge_density_q16, 0u) << size[0] << "x" << size[1];
+    }
+}
+
+TEST(EdgeProcessing, AsciiRendererDrawsMaskOnDemand) {
+    EdgeMask mask(130, 4);
+    mask.set(0, 0);
+    mask.set(64, 1);
+    mask.set(129, 3);
+
+    EXPECT_EQ(mask.count(), 3);
+
+    std::string full = AsciiRenderer::render(mask);
+    ASSERT_EQ(full.size(), (size_t)131 * 4);
+    EXPECT_EQ(full[0], '#');
+    EXPECT_EQ(full[131 + 64], '#');
+    EXPECT_EQ(full[3 * 131 + 129], '#');
+    EXPECT_EQ(std::count(full.begin(), full.end(), '#'), 3);
+    EXPECT_EQ(std::count(full.begin(), full.end(), '\n'), 4);
+
+    // Reduzido 4x: 33 colunas, 1 linha, um '#' por bloco que contem borda.
+    EXPECT_EQ(AsciiRenderer::render(mask, 4), "#" + std::string(15, '.') + "#" + std::string(15, '.') + "#\n");
+}
+
+TEST(EdgeProcessing, SteadyStateAnalyzeDoesNotAllocate) {
+    ImageFrame frame;
+    frame.width = 320;
+    frame.height = 240;
+    frame.data.resize(320 * 240);
+
+    std::mt19937 rng(5);
+    for (auto& p : frame.data) p = rng() & 0xFF;
+
+    for (int threads : { 1, 3 }) {
+        EdgeProcessor processor;
+        processor.setThreadCount(threads);
+        processor.setGradientOutput(true);
+
+        AnalysisResult result;
+        processor.analyze(frame, result);
+
+        g_allocations = 0;
+        g_countAllocations = true;
+        for (int i = 0; i < 5; i++) processor.analyze(frame, result);
+        g_countAllocations = false;
+
+        EXPECT_EQ(g_allocations.load(), 0) << "threads=" << threads;
+        EXPECT_GT(result.edge_density_q16, 0u);
+    }
+}
+
+TEST(EdgeProcessing, AnalyzesStridedRoiWithoutCopy) {
+    // Mosaico 200x150 com padding: stride de 256 bytes por linha.
+    const int stride = 256;
+    std::vector<uint8_t> mosaic(stride * 150, 0xEE);
+    std::mt19937 rng(9);
+    for (int y = 0; y < 150; y++) {
+        for (int x = 0; x < 200; x++) mosaic[y * stride + x] = (rng() % 6) ? 40 : 220;
+    }
+    ImageView full(mosaic.data(), 200, 150, stride);
+    ImageView roi = full.crop(37, 21, 90, 70);
+
+    ImageFrame copy;
+    copy.width = 90;
+    copy.height = 70;
+    for (int y = 0; y < 70; y++) {
+        copy.data.insert(copy.data.end(), roi.row(y), roi.row(y) + 90);
+    }
+
+    EdgeProcessor processor;
+    AnalysisResult fromView = processor.analyze(roi);
+    AnalysisResult fromCopy = processor.analyze(copy);
+
+    EXPECT_GT(fromView.edge_density_q16, 0u);
+    EXPECT_EQ(fromView.edge_density_q16, fromCopy.edge_density_q16);
+    EXPECT_EQ(fromView.edge_mask, fromCopy.edge_mask);
+}
+
+TEST(EdgeProcessing, IncrementalModeReusesUnchangedTiles) {
+    ImageFrame frame;
+    frame.width = 330;
+    frame.height = 200;
+    frame.data.resize(330 * 200);
+
+    std::mt19937 rng(21);
+    for (auto& p : frame.data) p = (rng() % 5) ? 70 : 230;
+
+    EdgeProcessor full;
+    EdgeProcessor incremental;
+    incremental.setIncremental(true, 64);
+
+    AnalysisResult first = incremental.analyze(frame);
+    EXPECT_EQ(first.tiles_total, 6 * 4);
+    EXPECT_EQ(first.tiles_reused, 0);
+    EXPECT_EQ(first.edge_mask, full.analyze(frame).edge_mask);
+
+    AnalysisResult same = incremental.analyze(frame);
+    EXPECT_EQ(same.tiles_reused, same.tiles_total);
+    EXPECT_EQ(same.edge_density_q16, first.edge_density_q16);
+
+    // Um pixel em (129, 63): o halo de 2 pixels alcanca os tiles (1,0), (2,0), (1,1) e (2,1).
+    frame.data[63 * 330 + 129] = 255;
+    frame.data[63 * 330 + 130] = 0;
+    AnalysisResult changed = incremental.analyze(frame);
+    AnalysisResult expected = full.analyze(frame);
+
+    EXPECT_EQ(changed.tiles_reused, changed.tiles_total - 4);
+    EXPECT_EQ(changed.edge_mask, expected.edge_mask);
+    EXPECT_EQ(changed.edge_density_q16, expected.edge_density_q16);
+}
+
+TEST(EdgeProcessing, PyramidRefinesOnlyEdgeBearingTiles) {
+    // 320x256 liso com uma fissura vertical dentro do tile (2,1) -> 5x4 tiles de 64.
+    ImageFrame frame;
+    frame.width = 320;
+    frame.height = 256;
+    frame.data.assign(320 * 256, 120);
+    for (int y = 70; y < 120; y++) {
+        for (int x = 150; x < 153; x++) frame.data[y * 320 + x] = 10;
+    }
+
+    EdgeProcessor full;
+    AnalysisResult expected = full.analyze(frame);
+
+    EdgeProcessor pyramid;
+    pyramid.setPyramid(true);
+    AnalysisResult result = pyramid.analyze(frame);
+
+    EXPECT_EQ(result.tiles_total, 20);
+    EXPECT_EQ(result.tiles_x, 5);
+    EXPECT_GE(result.tiles_refined, 1);
+    EXPECT_LT(result.tiles_refined, 20);
+    EXPECT_EQ(result.refined_tiles[1 * 5 + 2], 1);
+    EXPECT_EQ(result.refined_tiles[3 * 5 + 0], 0);
+
+    // Todas as bordas estao em tiles refinados: mascara e densidade batem com o caminho completo.
+    EXPECT_EQ(result.edge_mask, expected.edge_mask);
+    EXPECT_EQ(result.edge_density_q16, expected.edge_density_q16);
+}
+
+TEST(EdgeProcessing, PyramidKeepsThinCracksInSmoothTiles) {
+    // Concreto liso com textura fraca e uma fissura de 1 pixel (contraste 40) so no tile (3,2):
+    // a media 4x4 reduziria a fissura a 10 niveis, o contraste local mantem os 40.
+    ImageFrame frame;
+    frame.width = 384;
+    frame.height = 256;
+    frame.data.resize(384 * 256);
+    std::mt19937 rng(5);
+    for (auto& p : frame.data) p = 119 + rng() % 3;
+    for (int y = 140; y < 180; y++) frame.data[y * 384 + 220] = 80;
+
+    for (MagnitudeMode mode : { MagnitudeMode::L2, MagnitudeMode::L1, MagnitudeMode::LInf }) {
+        EdgeProcessor full;
+        full.setMagnitudeMode(mode);
+        full.setThreshold(30);
+        AnalysisResult expected = full.analyze(frame);
+        ASSERT_GT(expected.edge_density_q16, 0u);
+
+        // Guarda automatica: so os tiles em volta da fissura refinam e o resultado e exato.
+        EdgeProcessor pyramid;
+        pyramid.setMagnitudeMode(mode);
+        pyramid.setThreshold(30);
+        pyramid.setPyramid(true);
+        AnalysisResult result = pyramid.analyze(frame);
+        EXPECT_EQ(result.refined_tiles[2 * 6 + 3], 1);
+        EXPECT_EQ(result.refined_tiles[0], 0);
+        EXPECT_LT(result.tiles_refined, result.tiles_total / 2);
+        EXPECT_EQ(result.edge_mask, expected.edge_mask);
+        EXPECT_EQ(result.edge_density_q16, expected.edge_density_q16);
+    }
+
+    // Guarda acima do contraste da fissura: o tile e pulado e a densidade so pode cair.
+    EdgeProcessor coarse;
+    coarse.setThreshold(30);
+    coarse.setPyramid(true, 60);
+    AnalysisResult skipped = coarse.analyze(frame);
+    EXPECT_EQ(skipped.tiles_refined, 0);
+    EXPECT_EQ(skipped.edge_density_q16, 0u);
+}
+
+static_assert(Convolve3x3<Gaussian3x3>::separable && Convolve3x3<SobelX>::separable, "1-2-1 e Sobel sao separaveis");
+static_assert(Convolve3x3<ScharrY>::factors.col[2] == -1 && Convolve3x3<ScharrY>::factors.row[1] == -10, "Scharr = [1 0 -1] x [-3 -10 -3]");
+static_assert(Convolve3x3<PrewittX>::nonZeroTaps == 6 && Convolve3x3<Box3x3>::nonZeroTaps == 9, "taps zero descartados");
+
+TEST(EdgeProcessing, GradientOperatorsScaleOnVerticalRamp) {
+    // Rampa horizontal constante em y: gy = 0 e gx so depende da suavizacao vertical do operador
+    // (Sobel 1-2-1 = 4, Scharr 3-10-3 = 16, Prewitt 1-1-1 = 3).
+    ImageFrame frame;
+    frame.width = 96;
+    frame.height = 40;
+    frame.data.resize(96 * 40);
+    for (int y = 0; y < 40; y++) {
+        for (int x = 0; x < 96; x++) frame.data[y * 96 + x] = (x * 37) % 251;
+    }
+
+    AnalysisResult byOperator[3];
+    for (GradientOperator op : { GradientOperator::Sobel, GradientOperator::Scharr, GradientOperator::Prewitt }) {
+        EdgeProcessor processor;
+        processor.setGradientOperator(op);
+        processor.setGradientOutput(true);
+        byOperator[(int)op] = processor.analyze(frame);
+    }
+
+    const auto& sobel = byOperator[0].gradient_magnitude;
+    const auto& scharr = byOperator[1].gradient_magnitude;
+    const auto& prewitt = byOperator[2].gradient_magnitude;
+    for (int y = 1; y < 39; y++) {
+        for (int x = 1; x < 95; x++) {
+            int i = y * 96 + x;
+            EXPECT_EQ(scharr[i], 4 * sobel[i]);
+            EXPECT_EQ(4 * prewitt[i], 3 * sobel[i]);
+        }
+    }
+
+    // Kernels SIMD de Scharr/Prewitt (mascara direta e niveis do limiar adaptativo) dao o mesmo
+    // resultado do escalar em ruido, em todas as metricas.
+    std::mt19937 rng(5);
+    for (auto& p : frame.data) p = rng() & 0xFF;
+    for (GradientOperator op : { GradientOperator::Scharr, GradientOperator::Prewitt }) {
+        for (MagnitudeMode mode : { MagnitudeMode::L2, MagnitudeMode::L1, MagnitudeMode::LInf }) {
+            for (ThresholdMode thresholdMode : { ThresholdMode::Fixed, ThresholdMode::Otsu }) {
+                EdgeProcessor reference;
+                reference.setKernels(KernelIsa::Scalar);
+                reference.setGradientOperator(op);
+                reference.setMagnitudeMode(mode);
+                reference.setThresholdMode(thresholdMode);
+                AnalysisResult expected = reference.analyze(frame);
+
+                for (KernelIsa isa : { KernelIsa::SSE2, KernelIsa::AVX2 }) {
+                    EdgeProcessor processor;
+                    if (!processor.setKernels(isa)) continue;
+                    processor.setGradientOperator(op);
+                    processor.setMagnitudeMode(mode);
+                    processor.setThresholdMode(thresholdMode);
+                    EXPECT_EQ(processor.analyze(frame).edge_mask, expected.edge_mask)
+                        << processor.activeKernels().name << " op " << (int)op << " mode " << (int)mode;
+                }
+            }
+        }
+    }
+}
+
+TEST(EdgeProcessing, AdaptiveThresholdFollowsSceneContrast) {
+    // Mesma fissura numa parede clara e num tunel escuro (contraste 5x menor).
+    auto scene = [](int background, int crack) {
+        ImageFrame frame;
+        frame.width = 200;
+        frame.height = 120;
+        frame.data.resize(200 * 120);
+        std::mt19937 rng(3);
+        for (auto& p : frame.data) p = background + (int)(rng() % 5) - 2;
+        for (int y = 10; y < 110; y++) {
+            for (int x = 98; x < 102; x++) frame.data[y * 200 + x] = crack;
+        }
+        return frame;
+    };
+    ImageFrame bright = scene(200, 50);
+    ImageFrame dim = scene(40, 10);
+
+    EdgeProcessor fixed;
+    EXPECT_GT(fixed.analyze(bright).edge_mask.count(), 0);
+    EXPECT_EQ(fixed.analyze(dim).edge_mask.count(), 0);
+
+    for (ThresholdMode mode : { ThresholdMode::Otsu, ThresholdMode::Percentile }) {
+        EdgeProcessor adaptive;
+        adaptive.setThresholdMode(mode, 97);
+        AnalysisResult a = adaptive.analyze(bright);
+        AnalysisResult b = adaptive.analyze(dim);
+        EXPECT_LT(b.threshold, a.threshold);
+        EXPECT_TRUE(b.edge_mask.get(97, 60) || b.edge_mask.get(98, 60));
+        EXPECT_FALSE(b.edge_mask.get(30, 60));
+    }
+
+    // No L1 os limites adaptativos sao exatos: mesmo resultado do limiar fixo reportado.
+    EdgeProcessor adaptive;
+    adaptive.setMagnitudeMode(MagnitudeMode::L1);
+    adaptive.setThresholdMode(ThresholdMode::Otsu);
+    AnalysisResult chosen = adaptive.analyze(dim);
+    fixed.setMagnitudeMode(MagnitudeMode::L1);
+    fixed.setThreshold(chosen.threshold);
+    EXPECT_EQ(fixed.analyze(dim).edge_mask, chosen.edge_mask);
+
+    // Kernels SIMD e faixas paralelas escolhem o mesmo limiar e a mesma mascara do escalar.
+    EdgeProcessor reference;
+    reference.setKernels(KernelIsa::Scalar);
+    reference.setThresholdMode(ThresholdMode::Otsu);
+    AnalysisResult expected = reference.analyze(bright);
+    for (KernelIsa isa : { KernelIsa::SSE2, KernelIsa::AVX2 }) {
+        EdgeProcessor processor;
+        if (!processor.setKernels(isa)) continue;
+        processor.setThresholdMode(ThresholdMode::Otsu);
+        processor.setThreadCount(3);
+        AnalysisResult result = processor.analyze(bright);
+        EXPECT_EQ(result.threshold, expected.threshold);
+        EXPECT_EQ(result.edge_mask, expected.edge_mask);
+    }
+
+    // O histograma conta todos os pixels internos (uma amostra de linhas erra aqui): no L1 o
+    // percentil separa exatamente os 8% mais fortes.
+    ImageFrame textured = bright;
+    std::mt19937 rng(3);
+    for (auto& p : textured.data) p = 200 + (int)(rng() % 15) - 7;
+    for (int y = 10; y < 110; y++) {
+        for (int x = 98; x < 102; x++) textured.data[y * 200 + x] = 50;
+    }
+    long interior = (long)(textured.width - 2) * (textured.height - 2);
+    for (KernelIsa isa : { KernelIsa::Scalar, KernelIsa::SSE2, KernelIsa::AVX2 }) {
+        EdgeProcessor percentile;
+        if (!percentile.setKernels(isa)) continue;
+        percentile.setMagnitudeMode(MagnitudeMode::L1);
+        percentile.setThresholdMode(ThresholdMode::Percentile, 92);
+        AnalysisResult result = percentile.analyze(textured);
+        ASSERT_GE(result.threshold, 4);
+        EXPECT_LE(result.edge_mask.count() * 100, interior * 8);
+
+        EdgeProcessor below;
+        below.setMagnitudeMode(MagnitudeMode::L1);
+        below.setThreshold(result.threshold - 4);
+        EXPECT_GT(below.analyze(textured).edge_mask.count() * 100, interior * 8);
+    }
+
+    // Largura multipla de 64 (mascara da faixa numa chamada so) e densidade tirada do histograma:
+    // iguais as do limiar fixo reportado, que conta a mascara.
+    ImageFrame wide;
+    wide.width = 128;
+    wide.height = 48;
+    wide.data.resize(128 * 48);
+    for (auto& p : wide.data) p = 120 + (int)(rng() % 31) - 15;
+    for (KernelIsa isa : { KernelIsa::Scalar, KernelIsa::SSE2, KernelIsa::AVX2 }) {
+        EdgeProcessor processor;
+        if (!processor.setKernels(isa)) continue;
+        processor.setMagnitudeMode(MagnitudeMode::L1);
+        processor.setThresholdMode(ThresholdMode::Otsu);
+        processor.setThreadCount(2);
+        AnalysisResult result = processor.analyze(wide);
+
+        EdgeProcessor same;
+        same.setKernels(isa);
+        same.setMagnitudeMode(MagnitudeMode::L1);
+        same.setThreshold(result.threshold);
+        AnalysisResult expected = same.analyze(wide);
+        EXPECT_GT(expected.edge_mask.count(), 0);
+        EXPECT_EQ(result.edge_mask, expected.edge_mask);
+        EXPECT_EQ(result.edge_density_q16, expected.edge_density_q16);
+    }
+}
+
+TEST(EdgeProcessing, CrackSegmenterMatchesFloodFill) {
+    // Mascaras aleatorias contra um flood fill ingenuo (vizinhanca 8) sobre a mascara inteira.
+    std::mt19937 rng(21);
+    CrackSegmenter segmenter(1);
+    for (int round = 0; round < 20; round++) {
+        int w = 30 + rng() % 150;
+        int h = 5 + rng() % 60;
+        EdgeMask mask(w, h);
+        for (int y = 0; y < h; y++) {
+            for (int x = 0; x < w; x++) {
+                if (rng() % 100 < 35) mask.set(x, y);
+            }
+        }
+
+        std::vector<CrackSegment> expected;
+        std::vector<uint8_t> seen((size_t)w * h, 0);
+        for (int y = 0; y < h; y++) {
+            for (int x = 0; x < w; x++) {
+                if (!mask.get(x, y) || seen[y * w + x]) continue;
+                CrackSegment seg = { x, y, x, y, 0, 0 };
+                std::vector<std::pair<int, int>> stack = { { x, y } };
+                seen[y * w + x] = 1;
+                while (!stack.empty()) {
+                    auto [px, py] = stack.back();
+                    stack.pop_back();
+                    seg.pixels++;
+                    seg.x0 = std::min(seg.x0, px);
+                    seg.x1 = std::max(seg.x1, px);
+                    seg.y0 = std::min(seg.y0, py);
+                    seg.y1 = std::max(seg.y1, py);
+                    for (int dy = -1; dy <= 1; dy++) {
+                        for (int dx = -1; dx <= 1; dx++) {
+                            int nx = px + dx;
+                            int ny = py + dy;
+                            if (nx < 0 || ny < 0 || nx >= w || ny >= h) continue;
+                            if (!mask.get(nx, ny) || seen[ny * w + nx]) continue;
+                            seen[ny * w + nx] = 1;
+                            stack.push_back({ nx, ny });
+                        }
+                    }
+                }
+                seg.extent = std::max(seg.x1 - seg.x0, seg.y1 - seg.y0) + 1;
+                expected.push_back(seg);
+            }
+        }
+
+        std::vector<CrackSegment> segments;
+        EXPECT_EQ(segmenter.segment(mask, segments), 0);
+        auto key = [](const CrackSegment& s) { return std::make_tuple(s.y0, s.x0, s.y1, s.x1, s.pixels, s.extent); };
+        auto byKey = [&](const CrackSegment& a, const CrackSegment& b) { return key(a) < key(b); };
+        std::sort(segments.begin(), segments.end(), byKey);
+        std::sort(expected.begin(), expected.end(), byKey);
+        ASSERT_EQ(segments.size(), expected.size()) << w << "x" << h;
+        for (size_t i = 0; i < segments.size(); i++) EXPECT_EQ(key(segments[i]), key(expected[i]));
+    }
+}
+
+TEST(EdgeProcessing, SegmentationReportsCracksAndDropsSpecks) {
+    // Uma fissura diagonal longa, uma vertical curta e pontos isolados de ruido.
+    ImageFrame frame;
+    frame.width = 160;
+    frame.height = 120;
+    frame.data.assign(160 * 120, 150);
+    for (int y = 10; y < 110; y++) {
+        for (int x = 20 + y / 2; x < 23 + y / 2; x++) frame.data[y * 160 + x] = 20;
+    }
+    for (int y = 30; y < 60; y++) {
+        for (int x = 130; x < 132; x++) frame.data[y * 160 + x] = 20;
+    }
+    frame.data[100 * 160 + 140] = 0;
+    frame.data[15 * 160 + 110] = 0;
+
+    EdgeProcessor processor;
+    processor.setSegmentation(true, 40);
+    AnalysisResult result = processor.analyze(frame);
+
+    ASSERT_EQ(result.segments.size(), 2u);
+    EXPECT_EQ(result.segments_dropped, 2);
+    long pixels = 0;
+    for (const CrackSegment& seg : result.segments) pixels += seg.pixels;
+    EXPECT_LT(pixels, result.edge_mask.count());
+
+    const CrackSegment& diagonal = result.segments[0].extent > result.segments[1].extent ? result.segments[0] : result.segments[1];
+    const CrackSegment& vertical = &diagonal == &result.segments[0] ? result.segments[1] : result.segments[0];
+    EXPECT_GE(diagonal.extent, 100);
+    EXPECT_LE(diagonal.y0, 10);
+    EXPECT_GE(diagonal.y1, 109);
+    EXPECT_LE(vertical.x0, 130);
+    EXPECT_GE(vertical.x1, 131);
+    EXPECT_EQ(vertical.extent, vertical.y1 - vertical.y0 + 1);
+
+    std::string json = PacketBuilder::build("ESP32-TEST-01", SensorData{}, result);
+    EXPECT_NE(json.find("\"segments\": [{\"x\": "), std::string::npos);
+}
+
+TEST(EdgeProcessing, OrientationHistogramFindsCrackDirection) {
+    // Classificacao sem atan contra atan2, fora de uma faixa estreita em volta das divisas dos bins.
+    for (int gy = -60; gy <= 60; gy++) {
+        for (int gx = -60; gx <= 60; gx++) {
+            if (gx == 0 && gy == 0) continue;
+            double deg = std::atan2(gy, gx) * 180.0 / M_PI + 90.0;
+            deg = std::fmod(deg + 360.0, 180.0);
+            double pos = deg / 11.25 + 0.5;
+            if (std::abs(pos - std::round(pos)) < 0.02) continue;
+            ASSERT_EQ(orientationBin(gx, gy), (int)std::floor(pos) % 16) << gx << "," << gy;
+        }
+    }
+
+    auto crack = [](int dx, int dy) {
+        ImageFrame frame;
+        frame.width = 192;
+        frame.height = 128;
+        frame.data.assign(192 * 128, 160);
+        for (int t = -200; t <= 200; t++) {
+            int cx = 96 + t * dx;
+            int cy = 64 + t * dy;
+            for (int k = 0; k < 3; k++) {
+                int x = dy ? cx + k : cx;
+                int y = dy ? cy : cy + k;
+                if (x >= 0 && x < 192 && y >= 0 && y < 128) frame.data[y * 192 + x] = 30;
+            }
+        }
+        return frame;
+    };
+
+    EdgeProcessor processor;
+    processor.setOrientationOutput(true);
+    EXPECT_EQ(processor.analyze(crack(1, 0)).dominant_direction_deg, 0);
+    EXPECT_EQ(processor.analyze(crack(0, 1)).dominant_direction_deg, 90);
+    AnalysisResult diagonal = processor.analyze(crack(1, 1));
+    EXPECT_EQ(diagonal.dominant_direction_deg, 45);
+
+    // Faixas paralelas, tiles incrementais e piramide (aqui todos os tiles refinam) somam o mesmo histograma.
+    processor.setThreadCount(3);
+    AnalysisResult parallel = processor.analyze(crack(1, 1));
+    processor.setThreadCount(1);
+    processor.setIncremental(true, 64);
+    processor.analyze(crack(1, 1));
+    AnalysisResult incremental = processor.analyze(crack(1, 1));
+    EXPECT_EQ(incremental.tiles_reused, incremental.tiles_total);
+    processor.setIncremental(false);
+    processor.setPyramid(true, 0);
+    AnalysisResult pyramid = processor.analyze(crack(1, 1));
+    for (int i = 0; i < kOrientationBins; i++) {
+        EXPECT_EQ(parallel.orientation_histogram[i], diagonal.orientation_histogram[i]) << i;
+        EXPECT_EQ(incremental.orientation_histogram[i], diagonal.orientation_histogram[i]) << i;
+        EXPECT_EQ(pyramid.orientation_histogram[i], diagonal.orientation_histogram[i]) << i;
+    }
+
+    std::string json = PacketBuilder::build("ESP32-TEST-01", SensorData{}, diagonal);
+    EXPECT_NE(json.find("\"dominant_direction_deg\": 45"), std::string::npos);
+    EXPECT_NE(json.find("\"orientation_permille\": ["), std::string::npos);
+
+    // Desligado: histograma vazio e sem direcao.
+    EdgeProcessor plain;
+    EXPECT_EQ(plain.analyze(crack(1, 1)).dominant_direction_deg, -1);
+}
+
+TEST(EdgeProcessing, AlarmEstimateStopsWhenDecided) {
+    ImageFrame noisy;
+    noisy.width = 320;
+    noisy.height = 240;
+    noisy.data.resize(320 * 240);
+    std::mt19937 rng(21);
+    for (auto& p : noisy.data) p = (rng() % 5) ? 120 : 200;
+
+    ImageFrame quiet;
+    quiet.width = 320;
+    quiet.height = 240;
+    quiet.data.assign(320 * 240, 140);
+    for (int y = 20; y < 220; y++) quiet.data[y * 320 + 150] = 30;
+
+    EdgeProcessor exact;
+    AnalysisResult noisyExact = exact.analyze(noisy);
+    AnalysisResult quietExact = exact.analyze(quiet);
+    EXPECT_EQ(noisyExact.confidence_q16, q16::One);
+    EXPECT_EQ(noisyExact.sampled_pixels, 0);
+
+    EdgeProcessor processor;
+    processor.setAlarmEstimate(true, q16::fromRatio(10, 100));
+
+    // Bem acima e bem abaixo do alarme: a amostra decide antes do orcamento, com estimativa proxima.
+    AnalysisResult high = processor.analyze(noisy);
+    EXPECT_TRUE(high.alarm);
+    EXPECT_GT(high.sampled_pixels, 0);
+    EXPECT_LT(high.sampled_pixels, 8192);
+    EXPECT_NEAR((double)high.edge_density_q16, (double)noisyExact.edge_density_q16, 0.05 * q16::One);
+    EXPECT_GT(high.confidence_q16, 64000u);
+    EXPECT_LT(high.confidence_q16, q16::One);
+    EXPECT_EQ(high.edge_mask.count(), 0);
+
+    AnalysisResult low = processor.analyze(quiet);
+    EXPECT_FALSE(low.alarm);
+    EXPECT_GT(low.sampled_pixels, 0);
+    EXPECT_LT(quietExact.edge_density_q16, q16::fromRatio(10, 100));
+
+    // Alarme exatamente na densidade real: a amostra nao decide e o passo completo responde.
+    processor.setAlarmEstimate(true, noisyExact.edge_density_q16);
+    AnalysisResult ambiguous = processor.analyze(noisy);
+    EXPECT_EQ(ambiguous.sampled_pixels, 0);
+    EXPECT_TRUE(ambiguous.alarm);
+    EXPECT_EQ(ambiguous.confidence_q16, q16::One);
+    EXPECT_EQ(ambiguous.edge_mask, noisyExact.edge_mask);
+}
+
+TEST(EdgeProcessing, BatchKeepsInputOrderAcrossWorkers) {
+    // Frames de tamanhos e conteudos diferentes, para que as tarefas terminem fora de ordem.
+    std::vector<ImageFrame> frames(11);
+    std::mt19937 rng(17);
+    for (size_t i = 0; i < frames.size(); i++) {
+        ImageFrame& frame = frames[i];
+        frame.width = 64 + 24 * (int)(i % 4);
+        frame.height = 48 + 16 * (int)(i % 3);
+        frame.data.resize((size_t)frame.width * frame.height);
+        for (auto& p : frame.data) p = (rng() % (2 + i)) ? 100 : 220;
+    }
+
+    EdgeProcessor reference;
+    reference.setSegmentation(true, 4);
+    std::vector<AnalysisResult> expected;
+    for (const ImageFrame& frame : frames) expected.push_back(reference.analyze(frame));
+
+    for (int threads : { 1, 3 }) {
+        EdgeProcessor processor;
+        processor.setThreadCount(threads);
+        processor.setSegmentation(true, 4);
+
+        std::vector<AnalysisResult> results = processor.analyzeBatch(frames);
+        ASSERT_EQ(results.size(), frames.size());
+        for (size_t i = 0; i < frames.size(); i++) {
+            EXPECT_EQ(results[i].edge_mask, expected[i].edge_mask) << threads << " " << i;
+            EXPECT_EQ(results[i].edge_density_q16, expected[i].edge_density_q16);
+            EXPECT_EQ(results[i].segments.size(), expected[i].segments.size());
+        }
+
+        // Em fluxo: indices em ordem, resultados iguais, e o lote pode ser repetido no mesmo objeto.
+        for (int pass = 0; pass < 2; pass++) {
+            size_t nextIndex = 0;
+            processor.analyzeBatch(frames, [&](size_t index, const AnalysisResult& result) {
+                EXPECT_EQ(index, nextIndex++);
+                EXPECT_EQ(result.edge_mask, expected[index].edge_mask) << threads << " " << index;
+            });
+            EXPECT_EQ(nextIndex, frames.size());
+        }
+    }
+}
+
+// Passadas de box blur 3x3 no interior: contraste parecido, pouca alta frequencia.
+static ImageFrame boxBlurred(const ImageFrame& frame, int passes) {
+    ImageFrame blurry = frame;
+    int w = frame.width;
+    for (int pass = 0; pass < passes; pass++) {
+        std::vector<uint8_t> out = blurry.data;
+        for (int y = 1; y < frame.height - 1; y++) {
+            for (int x = 1; x < w - 1; x++) {
+                int sum = 0;
+                for (int dy = -1; dy <= 1; dy++) {
+                    for (int dx = -1; dx <= 1; dx++) sum += blurry.data[(y + dy) * w + x + dx];
+                }
+                out[y * w + x] = sum / 9;
+            }
+        }
+        blurry.data = out;
+    }
+    return blurry;
+}
+
+TEST(EdgeProcessing, SharpnessGateRejectsBlurredFrames) {
+    ImageFrame sharp;
+    sharp.width = 160;
+    sharp.height = 120;
+    sharp.data.resize(160 * 120);
+    std::mt19937 rng(5);
+    for (auto& p : sharp.data) p = 80 + rng() % 96;
+    ImageFrame blurry = boxBlurred(sharp, 4);
+
+    EdgeProcessor processor;
+    processor.setSharpnessGate(true, 100);
+    AnalysisResult kept = processor.analyze(sharp);
+    EXPECT_EQ(kept.reject_reason, RejectReason::None);
+    EXPECT_GT(kept.sharpness, 100u);
+    EXPECT_GT(kept.edge_mask.count(), 0);
+
+    AnalysisResult rejected = processor.analyze(blurry);
+    EXPECT_EQ(rejected.reject_reason, RejectReason::Blurry);
+    EXPECT_LT(rejected.sharpness, 100u);
+    EXPECT_EQ(rejected.edge_mask.count(), 0);
+    EXPECT_EQ(rejected.confidence_q16, 0u);
+
+    processor.analyze(blurry);
+    EXPECT_EQ(processor.qualityStats().frames, 3u);
+    EXPECT_EQ(processor.qualityStats().rejected, 2u);
+
+    // Lotes contam nos processadores internos; o total e somado.
+    processor.resetQualityStats();
+    processor.setThreadCount(2);
+    processor.analyzeBatch(std::vector<ImageFrame>{ sharp, blurry, blurry, sharp });
+    EXPECT_EQ(processor.qualityStats().frames, 4u);
+    EXPECT_EQ(processor.qualityStats().rejected, 2u);
+
+    std::string json = PacketBuilder::build("ESP32-TEST-01", SensorData{}, rejected);
+    EXPECT_NE(json.find("\"reject_reason\": \"blurry\""), std::string::npos);
+}
+
+TEST(EdgeProcessing, SharpnessGateCalibratesPerScene) {
+    // Cenas com nitidez de ordens de grandeza diferentes: nenhum limiar fixo serve para todas.
+    std::vector<ImageFrame> scenes;
+    ImageFrame texture;
+    texture.width = 160;
+    texture.height = 120;
+    texture.data.resize(160 * 120);
+    std::mt19937 rng(8);
+    for (auto& p : texture.data) p = 80 + rng() % 96;
+    scenes.push_back(texture);
+
+    ImageFrame concrete = texture;   // concreto liso (+-2) com duas fissuras finas
+    for (auto& p : concrete.data) p = 126 + rng() % 5;
+    for (int y = 10; y < 110; y++) {
+        concrete.data[y * 160 + 40 + y / 4] = 70;
+        concrete.data[y * 160 + 120] = 90;
+    }
+    scenes.push_back(concrete);
+
+    int w, h;
+    unsigned char* photo = ImageDecoder::loadGray((std::string(EDGE_SOURCE_DIR) + "/teste.jpg").c_str(), 4, &w, &h);
+    ASSERT_NE(photo, nullptr);
+    ImageFrame real;
+    real.width = w;
+    real.height = h;
+    real.data.assign(photo, photo + (size_t)w * h);
+    stbi_image_free(photo);
+    scenes.push_back(real);
+
+    // Padrao: o filtro mede mas nao descarta nada, nem o frame mais borrado.
+    EdgeProcessor measuring;
+    measuring.setSharpnessGate(true);
+    for (const ImageFrame& scene : scenes) {
+        AnalysisResult result = measuring.analyze(boxBlurred(scene, 2));
+        EXPECT_EQ(result.reject_reason, RejectReason::None);
+        EXPECT_GT(measuring.analyze(scene).sharpness, result.sharpness);
+    }
+
+    for (size_t i = 0; i < scenes.size(); i++) {
+        // Referencia: o frame nitido e duas variacoes de exposicao da mesma cena.
+        ImageFrame brighter = scenes[i], darker = scenes[i];
+        for (auto& p : brighter.data) p = (uint8_t)std::min(255, p + 6);
+        for (auto& p : darker.data) p = (uint8_t)std::max(0, p - 6);
+
+        EdgeProcessor processor;
+        uint32_t minimum = processor.calibrateSharpnessGate({ scenes[i], brighter, darker });
+        EXPECT_GT(minimum, 0u) << i;
+        EXPECT_EQ(processor.analyze(scenes[i]).reject_reason, RejectReason::None) << i;
+        EXPECT_EQ(processor.analyze(boxBlurred(scenes[i], 2)).reject_reason, RejectReason::Blurry) << i;
+    }
+}
+
+TEST(EdgeProcessing, ChangeDetectorSkipsUnchangedScenes) {
+    ImageFrame scene;
+    scene.width = 320;
+    scene.height = 240;
+    scene.data.resize(320 * 240);
+    std::mt19937 rng(31);
+    for (int y = 0; y < 240; y++) {
+        for (int x = 0; x < 320; x++) scene.data[y * 320 + x] = (uint8_t)(60 + (x + y) / 4 + rng() % 8);
+    }
+
+    ChangeDetector detector(2);
+    EXPECT_TRUE(detector.changed(scene));   // sem referencia
+
+    // Mesmo quadro com ruido de sensor de +-3 niveis: a media dos blocos 8x8 absorve.
+    ImageFrame noisy = scene;
+    for (auto& p : noisy.data) p = (uint8_t)std::min(255, std::max(0, p + (int)(rng() % 7) - 3));
+    EXPECT_FALSE(detector.changed(noisy));
+    EXPECT_LT(detector.lastDifference(), 2);
+
+    // Um objeto de 96x96 entra na cena.
+    ImageFrame moved = scene;
+    for (int y = 60; y < 156; y++) {
+        for (int x = 100; x < 196; x++) moved.data[y * 320 + x] = 230;
+    }
+    EXPECT_TRUE(detector.changed(moved));
+    EXPECT_GE(detector.lastDifference(), 2);
+    EXPECT_FALSE(detector.changed(moved));   // a referencia passou a ser o frame que mudou
+
+    // Deriva lenta de iluminacao: cada passo sozinho e pequeno, mas acumula contra a referencia.
+    int steps = 0;
+    ImageFrame drift = moved;
+    do {
+        for (auto& p : drift.data) p = (uint8_t)std::max(0, p - 1);
+        steps++;
+    } while (!detector.changed(drift) && steps < 10);
+    EXPECT_EQ(steps, 2);
+
+    // Mudanca de resolucao sempre conta; reset() forca a proxima analise.
+    ImageFrame small = scene;
+    small.width = 160;
+    small.height = 120;
+    small.data.resize(160 * 120);
+    EXPECT_TRUE(detector.changed(small));
+    detector.reset();
+    EXPECT_TRUE(detector.changed(small));
+
+    EdgeProcessor processor;
+    AnalysisResult last = processor.analyze(scene);
+    std::string heartbeat = PacketBuilder::heartbeat("ESP32-TEST-01", last, 3);
+    EXPECT_NE(heartbeat.find("\"heartbeat\": true, \"unchanged_cycles\": 3"), std::string::npos);
+    EXPECT_LT(heartbeat.size(), PacketBuilder::build("ESP32-TEST-01", SensorData{}, last).size() / 3);
+}
+
+TEST(Camera, FrameBufferPoolBoundsFramesInFlight) {
+    FrameBufferPool pool(2, 1000);
+    FrameLease a = pool.acquire();
+    FrameLease b = pool.acquire();
+    ASSERT_NE(a.data(), nullptr);
+    ASSERT_NE(b.data(), nullptr);
+    EXPECT_EQ((uintptr_t)a.data() % 64, 0u);
+    EXPECT_EQ((uintptr_t)b.data() % 64, 0u);
+    EXPECT_EQ(pool.acquire().data(), nullptr);   // todos emprestados
+    EXPECT_FALSE(a.setFrame(40, 30));            // 1200 bytes nao cabem
+    EXPECT_TRUE(a.setFrame(40, 25));
+    EXPECT_TRUE(a.valid());
+
+    // Mover transfere o buffer; destruir ou reset() devolve.
+    const uint8_t* buffer = a.data();
+    FrameLease moved = std::move(a);
+    EXPECT_FALSE(a.valid());
+    EXPECT_EQ(moved.data(), buffer);
+    EXPECT_EQ(moved.view().width, 40);
+    { FrameLease scoped = std::move(b); }
+    EXPECT_EQ(pool.available(), 1);
+    EXPECT_FALSE(pool.reserve(4, 1000));         // ainda ha lease em voo
+    moved.reset();
+    EXPECT_EQ(pool.available(), 2);
+    EXPECT_TRUE(pool.reserve(3, 2000));
+    {
+        FrameLease grown = pool.acquire(4000);  // cresce: nenhum buffer emprestado
+        EXPECT_EQ(grown.capacity(), 4000u);
+        EXPECT_EQ(pool.acquire(8000).data(), nullptr);
+    }
+
+    // Lease sobre memoria de outro dono (ex.: fb do driver): o dono recebe de volta uma vez.
+    std::vector<uint8_t> external(64, 7);
+    int returned = 0;
+    auto giveBack = [](void* counter) { ++*static_cast<int*>(counter); };
+    {
+        FrameLease borrowed = FrameLease::borrow(ImageView(external.data(), 8, 8, 8), giveBack, &returned);
+        FrameLease moved2 = std::move(borrowed);
+        EXPECT_TRUE(moved2.valid());
+        EXPECT_EQ(returned, 0);
+    }
+    EXPECT_EQ(returned, 1);
+
+    // Camera: o mesmo buffer volta a cada ciclo e a captura em regime nao aloca.
+    MockCamera camera;
+    EdgeProcessor processor;
+    AnalysisResult result;
+    { FrameLease warmup = camera.capture(); processor.analyze(warmup, result); }
+
+    g_allocations = 0;
+    g_countAllocations = true;
+    for (int i = 0; i < 3; i++) {
+        FrameLease frame = camera.capture();
+        ASSERT_TRUE(frame.valid());
+        processor.analyze(frame, result);
+    }
+    g_countAllocations = false;
+    EXPECT_EQ(g_allocations.load(), 0);
+    EXPECT_GT(result.edge_mask.count(), 0);
+
+    FrameLease first = camera.capture();
+    FrameLease second = camera.capture();
+    EXPECT_TRUE(first.valid());
+    EXPECT_TRUE(second.valid());
+    EXPECT_FALSE(camera.capture().valid());      // frames em voo limitados a frameBuffers()
+    EXPECT_FALSE(camera.setFrameBuffers(3));
+    first.reset();
+    second.reset();
+    EXPECT_TRUE(camera.setFrameBuffers(3));
+}
+
+TEST(Camera, CachedFileCameraServesPerturbedReplays) {
+    // PGM binario 96x64 num arquivo temporario (o stb_image le PGM como le JPEG).
+    const int w = 96, h = 64;
+    std::vector<uint8_t> pixels(w * h);
+    for (int i = 0; i < w * h; i++) pixels[i] = (uint8_t)(40 + (i * 7) % 160);
+    std::string path = ::testing::TempDir() + "file_camera_cache.pgm";
+    FILE* f = std::fopen(path.c_str(), "wb");
+    ASSERT_NE(f, nullptr);
+    std::fprintf(f, "P5\n%d %d\n255\n", w, h);
+    std::fwrite(pixels.data(), 1, pixels.size(), f);
+    std::fclose(f);
+
+    FileCamera camera(path);
+    camera.setCached(true);
+    FrameLease first = camera.capture();
+    ASSERT_TRUE(first.valid());
+    EXPECT_EQ(first.width(), w);
+    EXPECT_EQ(std::vector<uint8_t>(first.view().data, first.view().data + w * h), pixels);
+
+    // Sem perturbacao: sem copia e sem alocacao, todo frame e o proprio cache.
+    g_allocations = 0;
+    g_countAllocations = true;
+    FrameLease second = camera.capture();
+    g_countAllocations = false;
+    EXPECT_EQ(g_allocations.load(), 0);
+    EXPECT_EQ(second.view().data, first.view().data);
+
+    // Deslocamento: recorte de (w - 8) x (h - 8) em um offset de ate 8 pixels.
+    FramePerturbation shift;
+    shift.maxShift = 4;
+    camera.setCached(true, shift);
+    bool moved = false;
+    for (int i = 0; i < 8; i++) {
+        FrameLease frame = camera.capture();
+        ImageView view = frame.view();
+        ASSERT_EQ(view.width, w - 8);
+        ASSERT_EQ(view.height, h - 8);
+        long offset = view.data - camera.capture().view().data;
+        moved |= offset != 0;
+    }
+    EXPECT_TRUE(moved);
+
+    // Ruido e ganho: escrito num buffer do pool, perto do original e diferente a cada captura.
+    FramePerturbation noisy;
+    noisy.noise = 3;
+    noisy.gainPercent = 10;
+    camera.setCached(true, noisy);
+    FrameLease a = camera.capture();
+    FrameLease b = camera.capture();
+    ASSERT_TRUE(a.valid() && b.valid());
+    EXPECT_NE(a.data(), nullptr);
+    int differing = 0;
+    for (int i = 0; i < w * h; i++) {
+        int original = pixels[i];
+        EXPECT_NEAR(a.data()[i], original, original * 10 / 100 + 4) << i;
+        differing += a.data()[i] != b.data()[i];
+    }
+    EXPECT_GT(differing, w * h / 2);
+    std::remove(path.c_str());
+}
+
+TEST(EdgeProcessing, FixedPointPathIsIntegerExact) {
+    ImageFrame frame;
+    frame.width = 211;
+    frame.height = 67;
+    frame.data.resize(211 * 67);
+    std::mt19937 rng(8);
+    for (auto& p : frame.data) p = (rng() % 3) ? 90 : 200;
+
+    EdgeProcessor processor;
+    processor.setKernels(KernelIsa::Scalar);
+    processor.setGradientOutput(true);
+    AnalysisResult result = processor.analyze(frame);
+
+    // Densidade Q16 = floor(bordas * 65536 / pixels), igual em qualquer build.
+    EXPECT_EQ(result.edge_density_q16, q16::fromRatio(result.edge_mask.count(), 211 * 67));
+    EXPECT_EQ(result.confidence_q16, q16::One);   // passo completo: densidade exata
+
+    // Raiz inteira da magnitude bate com (int)sqrt da referencia em ponto flutuante.
+    auto blurred = [&](int x, int y) {
+        int sum = 0;
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                int cx = std::min(std::max(x + dx, 0), 210);
+                int cy = std::min(std::max(y + dy, 0), 66);
+                sum += (2 - std::abs(dx)) * (2 - std::abs(dy)) * frame.data[cy * 211 + cx];
+            }
+        }
+        return sum / 16;
+    };
+    for (int y = 1; y < 66; y++) {
+        for (int x = 1; x < 210; x++) {
+            int gx = blurred(x+1, y-1) + 2 * blurred(x+1, y) + blurred(x+1, y+1)
+                   - blurred(x-1, y-1) - 2 * blurred(x-1, y) - blurred(x-1, y+1);
+            int gy = blurred(x-1, y+1) + 2 * blurred(x, y+1) + blurred(x+1, y+1)
+                   - blurred(x-1, y-1) - 2 * blurred(x, y-1) - blurred(x+1, y-1);
+            ASSERT_EQ(result.gradient_magnitude[y * 211 + x], (int)std::sqrt(gx*gx + gy*gy)) << x << "," << y;
+        }
+    }
+
+    EXPECT_EQ(q16::format(q16::One / 2, 4), "0.5000");
+    EXPECT_EQ(q16::format(62259, 4), "0.9500");
+    EXPECT_EQ(q16::format(q16::One * 100, 2), "100.00");
+    EXPECT_EQ(q16::format(3, 4), "0.0000");
 }
 
 
@@ -34,6 +1156,8 @@ TEST(SystemIntegration, GeneratesValidJSON) {
     AnalysisResult fakeAnalysis;
     fakeAnalysis.edge_density = 0.1234f;
     fakeAnalysis.confidence = 0.85f;
+    fakeAnalysis.edge_density_q16 = 8087;   // 0.1234
+    fakeAnalysis.confidence_q16 = 55706;    // 0.85
     fakeAnalysis.process_time_ms = 150;
 
     std::string json = PacketBuilder::build("ESP32-TEST-01", fakeSensors, fakeAnalysis);
@@ -44,6 +1168,10 @@ TEST(SystemIntegration, GeneratesValidJSON) {
     EXPECT_NE(json.find("\"distance_mm\": 450"), std::string::npos);
     EXPECT_NE(json.find("\"edge_density\": 0.1234"), std::string::npos);
     EXPECT_NE(json.find("\"algorithm\": \"sobel_v1\""), std::string::npos);
+
+    // Carimbo da captura, nao do envio.
+    json = PacketBuilder::build("ESP32-TEST-01", fakeSensors, fakeAnalysis, (std::time_t)86400);
+    EXPECT_NE(json.find("\"timestamp\": \"1970-01-02T00:00:00Z\""), std::string::npos);
 }
 
 TEST(Communication, CreatesValidSerialFrame) {
@@ -66,4 +1194,296 @@ TEST(Communication, DetectsCorruptedData) {
     bool isValid = SerialProtocol::validate(packet);
     
     EXPECT_FALSE(isValid);
-}
\ No newline at end of file
+}
+
+TEST(Camera, SequenceCameraPrefetchesInOrder) {
+    // 10 PGMs 32x24 com o indice em todos os pixels, mais um arquivo que nao e imagem.
+    namespace fs = std::filesystem;
+    fs::path dir = fs::path(::testing::TempDir()) / "sequence_camera";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    const int w = 32, h = 24, n = 10;
+    for (int i = 0; i < n; i++) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "frame_%03d.pgm", i);
+        FILE* f = std::fopen((dir / name).string().c_str(), "wb");
+        ASSERT_NE(f, nullptr);
+        std::fprintf(f, "P5\n%d %d\n255\n", w, h);
+        std::vector<uint8_t> pixels(w * h, (uint8_t)(i * 10));
+        std::fwrite(pixels.data(), 1, pixels.size(), f);
+        std::fclose(f);
+    }
+    std::ofstream(dir / "notas.txt") << "nao e frame\n";
+
+    // Decodificacao fora de ordem em 3 threads, entrega em ordem; fim da sequencia = lease invalido.
+    SequenceOptions options;
+    options.threads = 3;
+    options.prefetch = 4;
+    {
+        SequenceCamera camera(dir.string(), options);
+        ASSERT_TRUE(camera.init());
+        EXPECT_EQ(camera.frameCount(), (size_t)n);
+        for (int i = 0; i < n; i++) {
+            FrameLease frame = camera.capture();
+            ASSERT_TRUE(frame.valid()) << i;
+            EXPECT_EQ(frame.width(), w);
+            EXPECT_EQ(frame.data()[w * h / 2], i * 10) << i;
+        }
+        EXPECT_FALSE(camera.capture().valid());
+    }
+
+    // Consumidor segurando mais frames que o pool cobre (prefetch + 2): capture() falha em vez de
+    // travar, e volta a entregar (em ordem) quando um frame e solto.
+    {
+        SequenceOptions held;
+        held.threads = 1;
+        held.prefetch = 2;
+        SequenceCamera camera(dir.string(), held);
+        ASSERT_TRUE(camera.init());
+        std::vector<FrameLease> frames;
+        for (int i = 0; i < 4; i++) {
+            frames.push_back(camera.capture());
+            ASSERT_TRUE(frames.back().valid()) << i;
+        }
+        EXPECT_FALSE(camera.capture().valid());
+        frames.erase(frames.begin());
+        FrameLease next = camera.capture();
+        ASSERT_TRUE(next.valid());
+        EXPECT_EQ(next.data()[0], 40);
+    }
+
+    // Manifesto (caminhos relativos, comentarios) em loop e com taxa fixa de 200 frames/s, num
+    // relogio falso que so anda quando a camera espera.
+    std::ofstream(dir / "manifest.txt") << "# ordem propria\nframe_005.pgm\n\nframe_001.pgm\nframe_009.pgm\n";
+    options.loop = true;
+    options.fps = 200;
+    std::chrono::steady_clock::time_point clock;
+    std::vector<long long> waits;   // instantes (us desde o inicio) ate onde a camera esperou
+    options.now = [&] { return clock; };
+    options.sleepUntil = [&](std::chrono::steady_clock::time_point due) {
+        waits.push_back(std::chrono::duration_cast<std::chrono::microseconds>(due - std::chrono::steady_clock::time_point()).count());
+        clock = due;
+    };
+    {   // a camera (e os decodificadores do loop) para antes de apagar os arquivos
+        SequenceCamera looped((dir / "manifest.txt").string(), options);
+        ASSERT_TRUE(looped.init());
+        const int expected[] = { 50, 10, 90, 50, 10, 90, 50, 10, 90, 50, 10 };
+        for (int value : expected) {
+            FrameLease frame = looped.capture();
+            ASSERT_TRUE(frame.valid());
+            EXPECT_EQ(frame.data()[0], value);
+        }
+        // 11 frames a 200/s: o primeiro sai na hora, o k-esimo 5k ms depois dele.
+        ASSERT_EQ(waits.size(), 10u);
+        for (int k = 1; k <= 10; k++) EXPECT_EQ(waits[k - 1], 5000LL * k) << k;
+    }
+    fs::remove_all(dir);
+}
+
+TEST(Camera, ScaledJpegDecodeMatchesBlockAverage) {
+    // Foto real 3840x1728 (YCbCr 4:2:0): reducao no dominio da DCT contra media de blocos da
+    // decodificacao inteira.
+    std::string path = std::string(EDGE_SOURCE_DIR) + "/teste.jpg";
+    int fw, fh, channels;
+    unsigned char* full = stbi_load(path.c_str(), &fw, &fh, &channels, 1);
+    ASSERT_NE(full, nullptr);
+
+    for (int scale : { 2, 4, 8 }) {
+        int w, h;
+        unsigned char* img = ImageDecoder::loadGray(path.c_str(), scale, &w, &h);
+        ASSERT_NE(img, nullptr);
+        ASSERT_EQ(w, (fw + scale - 1) / scale);
+        ASSERT_EQ(h, (fh + scale - 1) / scale);
+        long error = 0;
+        for (int y = 0; y < h; y++) {
+            for (int x = 0; x < w; x++) {
+                int sum = 0, n = 0;
+                for (int yy = y * scale; yy < std::min(fh, (y + 1) * scale); yy++) {
+                    for (int xx = x * scale; xx < std::min(fw, (x + 1) * scale); xx++, n++) sum += full[yy * fw + xx];
+                }
+                error += std::abs(img[y * w + x] - (sum + n / 2) / n);
+            }
+        }
+        EXPECT_LT((double)error / (w * h), 0.5) << scale;
+        stbi_image_free(img);
+    }
+    stbi_image_free(full);
+
+    // Resolucao pedida: a maior reducao que ainda cobre 400x200 e 1/8 (480x216).
+    FileCamera camera(path);
+    camera.setRequestedResolution(400, 200);
+    FrameLease frame = camera.capture();
+    ASSERT_TRUE(frame.valid());
+    EXPECT_EQ(frame.width(), 480);
+    EXPECT_EQ(frame.height(), 216);
+    frame.reset();   // o pool so cresce para 1/2 sem frames em voo
+    camera.setRequestedResolution(1000, 0);
+    EXPECT_EQ(camera.capture().width(), 1920);
+
+    // Fora do JPEG (PGM): decodificacao inteira + media exata de blocos, bordas parciais incluidas.
+    const int pw = 10, ph = 6;
+    std::string pgm = ::testing::TempDir() + "scaled_decode.pgm";
+    FILE* f = std::fopen(pgm.c_str(), "wb");
+    ASSERT_NE(f, nullptr);
+    std::fprintf(f, "P5\n%d %d\n255\n", pw, ph);
+    for (int i = 0; i < pw * ph; i++) std::fputc(i % pw < 8 ? 40 : 200, f);
+    std::fclose(f);
+    int w, h;
+    unsigned char* img = ImageDecoder::loadGray(pgm.c_str(), 4, &w, &h);
+    ASSERT_NE(img, nullptr);
+    EXPECT_EQ(w, 3);
+    EXPECT_EQ(h, 2);
+    EXPECT_EQ(img[0], 40);
+    EXPECT_EQ(img[2], 200);
+    EXPECT_EQ(img[w + 2], 200);
+    stbi_image_free(img);
+    std::remove(pgm.c_str());
+}
+
+TEST(Camera, MappedRawCameraReplaysWithoutCopies) {
+    auto makeFrame = [](int w, int h, int seed) {
+        ImageFrame frame;
+        frame.width = w;
+        frame.height = h;
+        frame.valid = true;
+        frame.data.resize(w * h);
+        for (int i = 0; i < w * h; i++) frame.data[i] = (uint8_t)(seed + i * 13);
+        return frame;
+    };
+    ImageFrame a = makeFrame(40, 30, 1), b = makeFrame(40, 30, 2), c = makeFrame(24, 16, 3);
+
+    // Pilha de PGM: tamanhos livres, frames na ordem de escrita, fim = lease invalido.
+    std::string pgm = ::testing::TempDir() + "raw_stack.pgm";
+    {
+        RawRecordingWriter writer(pgm);
+        ASSERT_TRUE(writer.append(a) && writer.append(c) && writer.append(b));
+    }
+    MappedRawCamera stack(pgm);
+    ASSERT_TRUE(stack.init());
+    ASSERT_EQ(stack.frameCount(), 3u);
+    for (const ImageFrame* expected : { &a, &c, &b }) {
+        FrameLease frame = stack.capture();
+        ASSERT_TRUE(frame.valid());
+        ASSERT_EQ(frame.width(), expected->width);
+        ImageView view = frame.view();
+        EXPECT_EQ(std::vector<uint8_t>(view.data, view.data + view.width * view.height), expected->data);
+    }
+    EXPECT_FALSE(stack.capture().valid());
+
+    // Y4M mono em loop: o mesmo frame sai sempre do mesmo endereco do mapeamento, sem alocar.
+    std::string y4m = ::testing::TempDir() + "raw_mono.y4m";
+    {
+        RawRecordingWriter writer(y4m);
+        ASSERT_TRUE(writer.append(a) && writer.append(b));
+        EXPECT_FALSE(writer.append(c));   // Y4M: tamanho fixo
+    }
+    MappedRawCamera looped(y4m, true);
+    ASSERT_TRUE(looped.init());
+    ASSERT_EQ(looped.frameCount(), 2u);
+    const uint8_t* first = looped.capture().view().data;
+    looped.capture();
+    g_allocations = 0;
+    g_countAllocations = true;
+    FrameLease again = looped.capture();
+    g_countAllocations = false;
+    EXPECT_EQ(g_allocations.load(), 0);
+    EXPECT_EQ(again.view().data, first);
+    EXPECT_EQ(std::vector<uint8_t>(first, first + 40 * 30), a.data);
+
+    // Y4M 4:2:0 de outra ferramenta: so a luma, croma pulada.
+    std::string yuv = ::testing::TempDir() + "raw_420.y4m";
+    FILE* f = std::fopen(yuv.c_str(), "wb");
+    ASSERT_NE(f, nullptr);
+    std::fprintf(f, "YUV4MPEG2 W5 H3 F25:1 C420jpeg\n");
+    for (int k = 0; k < 2; k++) {
+        std::fprintf(f, "FRAME\n");
+        for (int i = 0; i < 15; i++) std::fputc(100 + k, f);
+        for (int i = 0; i < 12; i++) std::fputc(7, f);   // Cb, Cr: 3x2 cada
+    }
+    std::fclose(f);
+    MappedRawCamera yuvCamera(yuv);
+    ASSERT_TRUE(yuvCamera.init());
+    ASSERT_EQ(yuvCamera.frameCount(), 2u);
+    EXPECT_EQ(yuvCamera.frameView(1).at(4, 2), 101);
+
+    std::remove(pgm.c_str());
+    std::remove(y4m.c_str());
+    std::remove(yuv.c_str());
+}
+
+// Camera lenta de teste: cada captura leva `delayMs` e grava o numero do frame no primeiro pixel.
+// Camera falsa que conta as capturas: cada frame leva o numero de ordem (pixel 0) e a cena
+// atual (pixel 1); waitStarted() espera (sem medir tempo) ate n capturas terem comecado.
+class CountingCamera : public ICamera {
+public:
+    bool init() override { return true; }
+    FrameLease capture() override {
+        std::lock_guard<std::mutex> lock(mutex);
+        started++;
+        changed.notify_all();
+        FrameLease frame = framePool.acquire(64 * 48);
+        if (!frame.setFrame(64, 48)) return FrameLease();
+        frame.data()[0] = (uint8_t)count++;
+        frame.data()[1] = (uint8_t)scene;
+        return frame;
+    }
+    bool waitStarted(int n) {
+        std::unique_lock<std::mutex> lock(mutex);
+        return changed.wait_for(lock, std::chrono::seconds(10), [&] { return started >= n; });
+    }
+    void setScene(int value) {
+        std::lock_guard<std::mutex> lock(mutex);
+        scene = value;
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable changed;
+    int started = 0;
+    int count = 0;
+    int scene = 0;
+};
+
+TEST(Camera, AsyncCaptureOverlapsCaptureAndAnalysis) {
+    CountingCamera camera;
+    AsyncCapture capture(camera);
+    EXPECT_EQ(capture.acquire().data()[0], 0);   // sem start(): captura sincrona
+    capture.start();
+    for (int i = 1; i <= 10; i++) {
+        FrameLease frame = capture.acquire();
+        ASSERT_TRUE(frame.valid());
+        EXPECT_EQ(frame.data()[0], i);   // em ordem, nenhum frame perdido
+        // A captura i + 1 comeca enquanto o frame i ainda esta com o chamador (em "analise").
+        EXPECT_TRUE(camera.waitStarted(i + 2)) << i;
+    }
+    EXPECT_EQ(capture.framesAcquired(), 10);
+
+    // Segurando os 2 buffers do pool, a captura nao tem onde escrever: lease invalido, descartado,
+    // e a acquire() seguinte captura de novo.
+    FrameLease a = capture.acquire();
+    FrameLease b = capture.acquire();
+    ASSERT_TRUE(a.valid() && b.valid());
+    EXPECT_FALSE(capture.acquire().valid());
+    a.reset();
+    b.reset();
+    FrameLease retried = capture.acquire();
+    EXPECT_TRUE(retried.valid());
+    retried.reset();
+
+    // Sem prefetch a captura so comeca no pedido: o frame mostra a cena de depois do pedido.
+    capture.setPrefetch(false);
+    capture.acquire();          // descarta o frame ja pedido com prefetch
+    camera.setScene(7);
+    capture.request();
+    FrameLease fresh = capture.acquire();
+    ASSERT_TRUE(fresh.valid());
+    EXPECT_EQ(fresh.data()[1], 7);
+    EXPECT_GT(capture.capturedAt(), 0);
+    fresh.reset();
+    camera.setScene(9);
+    FrameLease unrequested = capture.acquire();   // sem request(): a propria acquire() captura
+    ASSERT_TRUE(unrequested.valid());
+    EXPECT_EQ(unrequested.data()[1], 9);
+    capture.stop();
+    EXPECT_FALSE(capture.running());
+}